@@ -0,0 +1,160 @@
+#pragma once
+#include "Logger.h"
+
+/*
+Vulkan调用追踪，定义VK_TRACE_CALLS时启用（CMake选项同名），否则本文件不产生任何代码。
+启用后graphics_base.dispatch中的每个函数都被换成先计时再调用驱动的thunk，统计每个函数每帧的调用次数和CPU耗时，
+以及创建/销毁的对象数（批量创建/销毁的函数按其数量参数计，见record(...)）。每帧结束时调用TraceFrameEnd()：
+1.每秒输出一次最耗时的函数的平均每帧调用次数和耗时；
+2.预热帧之后，若某帧调用了vkCreate或vkAllocate开头的函数则发出警告，用于发现误放进每帧逻辑的对象创建；
+3.若以open_trace_file(...)打开了追踪文件，则每帧把各函数的数据以CSV格式写入，便于回归比较。
+*/
+#ifdef VK_TRACE_CALLS
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <span>
+#include <string_view>
+
+namespace vulkan {
+
+class callTracer {
+public:
+    static constexpr uint32_t max_function_count = 64;
+    static constexpr uint32_t warm_up_frame_count = 16;
+    static constexpr uint32_t summary_line_count = 12; //每次输出的函数数，保证低于日志的频率限制
+private:
+    enum functionKind : uint8_t {
+        other,
+        creation,
+        destruction
+    };
+    struct counter {
+        std::atomic<uint64_t> call_count = 0;
+        std::atomic<uint64_t> nanoseconds = 0;
+        std::atomic<uint64_t> object_count = 0;
+    };
+    const char* names[max_function_count] = {};
+    functionKind kinds[max_function_count] = {};
+    uint32_t function_count = 0;
+    //以下由任意线程上的调用累加，帧结束时清零
+    counter frame_counters[max_function_count];
+    //以下只在调用end_frame()的线程上访问
+    uint64_t interval_call_counts[max_function_count] = {};
+    uint64_t interval_nanoseconds[max_function_count] = {};
+    uint64_t interval_frame_count = 0;
+    std::chrono::steady_clock::time_point interval_begin = std::chrono::steady_clock::now();
+    uint64_t frame_index = 0;
+    uint64_t total_created_object_count = 0;
+    uint64_t total_destroyed_object_count = 0;
+    std::FILE* trace_file = nullptr;
+
+    void log_summary() {
+        uint32_t order[max_function_count];
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < function_count; i++)
+            if (interval_call_counts[i])
+                order[count++] = i;
+        std::sort(order, order + count, [this](uint32_t a, uint32_t b) {
+            return interval_nanoseconds[a] > interval_nanoseconds[b];
+        });
+        LogInfo("[ callTracer ]\n{} frame(s), {} Vulkan object(s) alive (created {}, destroyed {})\n",
+            interval_frame_count, total_created_object_count - total_destroyed_object_count, total_created_object_count, total_destroyed_object_count);
+        for (uint32_t i = 0; i < std::min(count, summary_line_count); i++) {
+            uint32_t index = order[i];
+            LogInfo("    {:<36}{:>10.2f} call(s)/frame{:>12.3f} us/frame\n", names[index],
+                double(interval_call_counts[index]) / interval_frame_count, interval_nanoseconds[index] / 1000.0 / interval_frame_count);
+        }
+    }
+public:
+    callTracer() = default;
+    callTracer(callTracer&&) = delete;
+    ~callTracer() {
+        if (trace_file)
+            std::fclose(trace_file);
+    }
+    //Const Function
+    const char* function_name(uint32_t index) const { return names[index]; }
+    //Non-const Function
+    //以函数名登记被追踪的函数，函数名的下标即record(...)所用的index；按名称前缀区分创建和销毁
+    void set_functions(std::span<const char* const> function_names) {
+        function_count = uint32_t(std::min<size_t>(function_names.size(), max_function_count));
+        for (uint32_t i = 0; i < function_count; i++) {
+            std::string_view name = names[i] = function_names[i];
+            kinds[i] = name.starts_with("vkCreate") || name.starts_with("vkAllocate") ? creation :
+                name.starts_with("vkDestroy") || name.starts_with("vkFree") ? destruction : other;
+        }
+    }
+    bool open_trace_file(const char* path) {
+        if (!(trace_file = std::fopen(path, "w"))) {
+            LogError("[ callTracer ] ERROR\nFailed to open the trace file {}!\n", path);
+            return false;
+        }
+        std::fputs("frame,function,calls,nanoseconds\n", trace_file);
+        return true;
+    }
+    //object_count为这次调用创建或销毁的对象数，如vkAllocateCommandBuffers(...)的commandBufferCount，对其他函数无意义
+    void record(uint32_t index, uint64_t nanoseconds, uint32_t object_count = 1) {
+        frame_counters[index].call_count.fetch_add(1, std::memory_order_relaxed);
+        frame_counters[index].nanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+        frame_counters[index].object_count.fetch_add(object_count, std::memory_order_relaxed);
+    }
+    void end_frame() {
+        uint32_t frame_creation_count = 0;
+        const char* created_first = nullptr;
+        for (uint32_t i = 0; i < function_count; i++) {
+            uint64_t call_count = frame_counters[i].call_count.exchange(0, std::memory_order_relaxed);
+            uint64_t nanoseconds = frame_counters[i].nanoseconds.exchange(0, std::memory_order_relaxed);
+            uint64_t object_count = frame_counters[i].object_count.exchange(0, std::memory_order_relaxed);
+            if (!call_count)
+                continue;
+            interval_call_counts[i] += call_count;
+            interval_nanoseconds[i] += nanoseconds;
+            if (kinds[i] == creation) {
+                total_created_object_count += object_count;
+                frame_creation_count += uint32_t(call_count);
+                created_first = created_first ? created_first : names[i];
+            }
+            else if (kinds[i] == destruction)
+                total_destroyed_object_count += object_count;
+            if (trace_file)
+                std::fprintf(trace_file, "%llu,%s,%llu,%llu\n",
+                    (unsigned long long)frame_index, names[i], (unsigned long long)call_count, (unsigned long long)nanoseconds);
+        }
+        if (frame_creation_count && frame_index >= warm_up_frame_count)
+            LogWarning("[ callTracer ] WARNING\n{} object creation call(s) in frame {}, e.g. {}!\n",
+                frame_creation_count, frame_index, created_first);
+        frame_index++;
+        interval_frame_count++;
+        auto now = std::chrono::steady_clock::now();
+        if (now - interval_begin >= std::chrono::seconds(1)) {
+            log_summary();
+            std::fill(std::begin(interval_call_counts), std::end(interval_call_counts), 0);
+            std::fill(std::begin(interval_nanoseconds), std::end(interval_nanoseconds), 0);
+            interval_frame_count = 0;
+            interval_begin = now;
+        }
+    }
+};
+
+inline callTracer call_tracer;
+
+//在作用域结束时把耗时记到index对应的函数上
+class scopedCallTimer {
+    uint32_t index;
+    uint32_t object_count;
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+public:
+    scopedCallTimer(uint32_t index, uint32_t object_count = 1) :index(index), object_count(object_count) {}
+    scopedCallTimer(scopedCallTimer&&) = delete;
+    ~scopedCallTimer() {
+        call_tracer.record(index, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count(), object_count);
+    }
+};
+
+}
+
+#define TraceFrameEnd() vulkan::call_tracer.end_frame()
+#else
+#define TraceFrameEnd() ((void)0)
+#endif
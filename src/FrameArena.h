@@ -0,0 +1,219 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace vulkan {
+
+/*
+线性（bump）分配器：分配只是把偏移量往后推，不能单独释放，用完后整体reset()。
+容量不够时会再向堆申请一块更大的内存接着用，并在下次reset()时把所有块合并成一块，
+因此只要每帧用量不再增长，稳定后就不会再有任何堆分配。
+*/
+class linearArena {
+    struct block {
+        std::unique_ptr<std::byte[]> memory;
+        size_t capacity = 0;
+    };
+    std::vector<block> blocks;
+    size_t offset = 0; //在最后一块中的偏移量
+    size_t used = 0; //本轮已分配的总字节数（含对齐填充）
+    size_t peak = 0; //历史最大用量
+
+    void add_block(size_t capacity) {
+        blocks.push_back({ std::make_unique<std::byte[]>(capacity), capacity });
+        offset = 0;
+    }
+public:
+    linearArena() = default;
+    linearArena(size_t capacity) {
+        blocks.reserve(4);
+        add_block(capacity);
+    }
+    linearArena(linearArena&&) noexcept = default;
+    linearArena& operator=(linearArena&&) noexcept = default;
+    //Getter
+    size_t size() const { return used; }
+    size_t peak_size() const { return peak; }
+    size_t capacity() const {
+        size_t capacity = 0;
+        for (auto& i : blocks)
+            capacity += i.capacity;
+        return capacity;
+    }
+    //Non-const Function
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        if (!blocks.empty()) {
+            block& b = blocks.back();
+            uintptr_t base = reinterpret_cast<uintptr_t>(b.memory.get());
+            size_t aligned = (base + offset + alignment - 1) / alignment * alignment - base;
+            if (aligned + size <= b.capacity) {
+                used += aligned + size - offset;
+                offset = aligned + size;
+                return b.memory.get() + aligned;
+            }
+        }
+        //当前块不够，新块至少是已有总容量的两倍
+        add_block(std::max(capacity() * 2, size + alignment));
+        return allocate(size, alignment);
+    }
+    //在arena上构造一个对象，它不会被析构，因此T应可平凡析构
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+    //若ptr正好是最后一次分配的结尾，收回这部分空间，容器扩容时能原地复用
+    void deallocate(void* ptr, size_t size) {
+        if (blocks.empty())
+            return;
+        std::byte* end = blocks.back().memory.get() + offset;
+        if (static_cast<std::byte*>(ptr) + size == end) {
+            offset -= size;
+            used -= size;
+        }
+    }
+    void reset() {
+        peak = std::max(peak, used);
+        used = 0;
+        offset = 0;
+        //上一轮溢出过，把所有块合并成一块足以容纳历史峰值的内存
+        if (blocks.size() > 1) {
+            size_t capacity = this->capacity();
+            blocks.clear();
+            add_block(capacity);
+        }
+    }
+};
+
+//使标准库容器从linearArena中分配内存，deallocate(...)基本上什么都不做
+template<typename T>
+class arenaAllocator {
+    template<typename U>
+    friend class arenaAllocator;
+    linearArena* arena;
+public:
+    using value_type = T;
+    arenaAllocator(linearArena& arena) :arena(&arena) {}
+    template<typename U>
+    arenaAllocator(const arenaAllocator<U>& other) noexcept :arena(other.arena) {}
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* ptr, size_t n) noexcept {
+        arena->deallocate(ptr, n * sizeof(T));
+    }
+    template<typename U>
+    bool operator==(const arenaAllocator<U>& other) const noexcept { return arena == other.arena; }
+};
+
+//每帧临时使用的数组，如屏障、VkWriteDescriptorSet、VkSubmitInfo等
+template<typename T>
+using arenaVector = std::vector<T, arenaAllocator<T>>;
+
+/*
+每个飞行中的帧一个linearArena。
+某帧的栅栏置位后，GPU不再使用该帧CPU端构造的任何数据，此时begin_frame(...)整体重置该帧的arena。
+分配在arena上的对象不会被析构，只应存放可平凡析构的类型，或是生命周期不超过该帧的arenaVector。
+*/
+class frameArenas {
+    std::vector<linearArena> arenas;
+    uint32_t current_frame = 0;
+public:
+    frameArenas() = default;
+    frameArenas(uint32_t frame_count, size_t capacity_per_frame) {
+        create(frame_count, capacity_per_frame);
+    }
+    //Getter
+    linearArena& current() { return arenas[current_frame]; }
+    //Non-const Function
+    void create(uint32_t frame_count, size_t capacity_per_frame) {
+        arenas.clear();
+        arenas.reserve(frame_count);
+        for (uint32_t i = 0; i < frame_count; i++)
+            arenas.emplace_back(capacity_per_frame);
+        current_frame = 0;
+    }
+    //须在frame_index对应帧的栅栏置位后调用
+    linearArena& begin_frame(uint32_t frame_index) {
+        current_frame = frame_index;
+        arenas[frame_index].reset();
+        return arenas[frame_index];
+    }
+    template<typename T>
+    arenaVector<T> make_vector(size_t reserve_count = 0) {
+        auto vector = arenaVector<T>(arenaAllocator<T>(current()));
+        vector.reserve(reserve_count);
+        return vector;
+    }
+};
+
+/*
+堆分配计数，用来检查稳定状态下的帧是否完全没有全局堆分配。
+operator new的替换函数不能是inline的，因此需要在且仅在一个源文件中写DefineCountingOperatorNew，
+之后heap_allocation_count()返回至今经由operator new的分配次数（含带std::align_val_t的版本，不含C库的malloc）。
+*/
+inline std::atomic<uint64_t>& heap_allocation_count() {
+    static std::atomic<uint64_t> count = 0;
+    return count;
+}
+//各版本的operator new和operator delete都经由这两个函数，使分配和释放在编译器看来总是malloc和free成对
+inline void* counted_allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    heap_allocation_count().fetch_add(1, std::memory_order_relaxed);
+    if (alignment <= alignof(std::max_align_t))
+        return std::malloc(size ? size : 1);
+    //多分配alignment字节，在对齐后的地址之前保存malloc(...)返回的地址
+    void* raw = std::malloc(size + alignment);
+    if (!raw)
+        return nullptr;
+    void* p = reinterpret_cast<void*>((reinterpret_cast<uintptr_t>(raw) + alignment) & ~uintptr_t(alignment - 1));
+    static_cast<void**>(p)[-1] = raw;
+    return p;
+}
+//不内联，否则GCC在-Wall下会把new表达式的结果与内联进来的free(...)配对而误报
+#if defined(__GNUC__) || defined(__clang__)
+#define COUNTED_FREE_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define COUNTED_FREE_NOINLINE __declspec(noinline)
+#else
+#define COUNTED_FREE_NOINLINE
+#endif
+COUNTED_FREE_NOINLINE inline void counted_free(void* p, size_t alignment = alignof(std::max_align_t)) {
+    if (p && alignment > alignof(std::max_align_t))
+        p = static_cast<void**>(p)[-1];
+    std::free(p);
+}
+#define DefineCountingOperatorNew \
+void* operator new(size_t size) { \
+    if (void* p = vulkan::counted_allocate(size)) return p; \
+    throw std::bad_alloc(); \
+} \
+void* operator new[](size_t size) { \
+    if (void* p = vulkan::counted_allocate(size)) return p; \
+    throw std::bad_alloc(); \
+} \
+void* operator new(size_t size, std::align_val_t alignment) { \
+    if (void* p = vulkan::counted_allocate(size, size_t(alignment))) return p; \
+    throw std::bad_alloc(); \
+} \
+void* operator new[](size_t size, std::align_val_t alignment) { \
+    if (void* p = vulkan::counted_allocate(size, size_t(alignment))) return p; \
+    throw std::bad_alloc(); \
+} \
+void operator delete(void* p) noexcept { vulkan::counted_free(p); } \
+void operator delete[](void* p) noexcept { vulkan::counted_free(p); } \
+void operator delete(void* p, size_t) noexcept { vulkan::counted_free(p); } \
+void operator delete[](void* p, size_t) noexcept { vulkan::counted_free(p); } \
+void operator delete(void* p, std::align_val_t alignment) noexcept { vulkan::counted_free(p, size_t(alignment)); } \
+void operator delete[](void* p, std::align_val_t alignment) noexcept { vulkan::counted_free(p, size_t(alignment)); } \
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept { vulkan::counted_free(p, size_t(alignment)); } \
+void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept { vulkan::counted_free(p, size_t(alignment)); }
+
+}
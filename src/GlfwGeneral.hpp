@@ -11,11 +11,19 @@ GLFWmonitor* pMonitor;
 //窗口标题
 const char* windowTitle = "EasyVK";
 
+//VK_EXT_memory_budget依赖Vulkan 1.1（实例和物理设备均须支持）或实例扩展VK_KHR_get_physical_device_properties2，两者皆无时不启用
+void AddMemoryBudgetExtensionIfSupported() {
+    using vulkan::graphics_base;
+
+    if(graphics_base.physical_device_memory_properties2_name())
+        graphics_base.add_device_extension_if_supported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+}
+
 bool InitializeWindow(VkExtent2D size, bool fullScreen = false, bool isResizable = true, bool limitFrameRate = true) {
     using vulkan::graphics_base;
 
     if (!glfwInit()) {
-        std::cout << std::format("[ InitializeWindow ] ERROR\nFailed to initialize GLFW!\n");
+        LogError("[ InitializeWindow ] ERROR\nFailed to initialize GLFW!\n");
         return false;
     }
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -26,7 +34,7 @@ bool InitializeWindow(VkExtent2D size, bool fullScreen = false, bool isResizable
         glfwCreateWindow(pMode->width, pMode->height, windowTitle, pMonitor, nullptr) :
         glfwCreateWindow(size.width, size.height, windowTitle, nullptr, nullptr);
     if (!pWindow) {
-        std::cout << std::format("[ InitializeWindow ]\nFailed to create a glfw window!\n");
+        LogError("[ InitializeWindow ]\nFailed to create a glfw window!\n");
         glfwTerminate();
         return false;
     }
@@ -35,41 +43,72 @@ bool InitializeWindow(VkExtent2D size, bool fullScreen = false, bool isResizable
     const char** extensionNames;
     extensionNames = glfwGetRequiredInstanceExtensions(&extensionCount);
     if (!extensionNames) {
-        std::cout << std::format("[ InitializeWindow ]\nVulkan is not available on this machine!\n");
+        LogError("[ InitializeWindow ]\nVulkan is not available on this machine!\n");
         glfwTerminate();
         return false;
     }
     for (size_t i = 0; i < extensionCount; i++){
-        std::cout << std::format("[ InitializeWindow ]\nExtension {}: {}\n", i, extensionNames[i]);
+        LogDebug("[ InitializeWindow ]\nExtension {}: {}\n", i, extensionNames[i]);
         graphics_base.add_instance_extension(extensionNames[i]);
     }
     graphics_base.add_device_extension(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    //查询显存预算要用到Vulkan 1.1的vkGetPhysicalDeviceMemoryProperties2(...)
+    graphics_base.use_latest_version();
     if(graphics_base.create_instance()) {
-        std::cout << std::format("[ InitializeWindow ] ERROR\nFailed to create a Vulkan instance!\n");
+        LogError("[ InitializeWindow ] ERROR\nFailed to create a Vulkan instance!\n");
         return false;
     }
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     if(VkResult result = glfwCreateWindowSurface(graphics_base.instance, pWindow, nullptr, &surface)) {
-        std::cout << std::format("[ InitializeWindow ] ERROR\nFailed to create a window surface!\nError code: {}\n", int32_t(result));
+        LogError("[ InitializeWindow ] ERROR\nFailed to create a window surface!\nError code: {}\n", int32_t(result));
         glfwDestroyWindow(pWindow);
         glfwTerminate();
         return false;
     }
     graphics_base.surface = surface;
     if(graphics_base.get_physical_devices() ||
-        graphics_base.determine_physical_device(0,true,false) ||
-        graphics_base.create_device()) {
+        graphics_base.determine_physical_device(0,true,false)) {
 
-        std::cout << std::format("[ InitializeWindow ] ERROR\nFailed to create a Vulkan device!\n");
+        LogError("[ InitializeWindow ] ERROR\nFailed to determine a physical device!\n");
+        return false;
+    }
+    //可选，供residencyManager查询显存预算
+    AddMemoryBudgetExtensionIfSupported();
+    if(graphics_base.create_device()) {
+        LogError("[ InitializeWindow ] ERROR\nFailed to create a Vulkan device!\n");
         return false;
     }
     if(graphics_base.create_swapchain()) {
-        std::cout << std::format("[ InitializeWindow ] ERROR\nFailed to create a Vulkan swapchain!\n");
+        LogError("[ InitializeWindow ] ERROR\nFailed to create a Vulkan swapchain!\n");
         return false;
     }
     /*待Ch1-3和Ch1-4填充*/
     return true;
 }
+//不创建窗口、表面和交换链，只创建实例和设备，用于离屏渲染，或在没有显示器的机器上（如使用软件实现的驱动时）运行
+bool InitializeHeadless() {
+    using vulkan::graphics_base;
+
+    //查询显存预算要用到Vulkan 1.1的vkGetPhysicalDeviceMemoryProperties2(...)
+    graphics_base.use_latest_version();
+    if(graphics_base.create_instance()) {
+        LogError("[ InitializeHeadless ] ERROR\nFailed to create a Vulkan instance!\n");
+        return false;
+    }
+    if(graphics_base.get_physical_devices() ||
+        graphics_base.determine_physical_device(0,true,false)) {
+
+        LogError("[ InitializeHeadless ] ERROR\nFailed to determine a physical device!\n");
+        return false;
+    }
+    //可选，供residencyManager查询显存预算
+    AddMemoryBudgetExtensionIfSupported();
+    if(graphics_base.create_device()) {
+        LogError("[ InitializeHeadless ] ERROR\nFailed to create a Vulkan device!\n");
+        return false;
+    }
+    return true;
+}
 void TerminateWindow() {
     vulkan::graphics_base.wait_idle();
     glfwTerminate();
@@ -79,14 +118,12 @@ void TitleFps() {
     static double time1;
     static double dt;
     static int dframe = -1;
-    static std::stringstream info;
+    static char info[256];//用定长数组代替stringstream，稳定运行时不产生堆分配
     time1 = glfwGetTime();
     dframe++;
     if ((dt = time1 - time0) >= 1) {
-        info.precision(1);
-        info << windowTitle << "    " << std::fixed << dframe / dt << " FPS";
-        glfwSetWindowTitle(pWindow, info.str().c_str());
-        info.str("");//别忘了在设置完窗口标题后清空所用的stringstream
+        *std::format_to_n(info, std::size(info) - 1, "{}    {:.1f} FPS", windowTitle, dframe / dt).out = 0;
+        glfwSetWindowTitle(pWindow, info);
         time0 = time1;
         dframe = 0;
     }
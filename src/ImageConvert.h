@@ -0,0 +1,428 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//x86平台上使用SSE/AVX2，其他平台只有标量实现
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define IMAGE_CONVERT_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//GCC/Clang需要用target属性为单个函数开启指令集，这样无需全局开启-mavx2，运行时再分派
+#if defined(IMAGE_CONVERT_X86) && (defined(__GNUC__) || defined(__clang__))
+#define IMAGE_CONVERT_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define IMAGE_CONVERT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define IMAGE_CONVERT_TARGET_SSSE3
+#define IMAGE_CONVERT_TARGET_AVX2
+#endif
+
+/*
+stb_image输出的是紧密排列的8位RGB/RGBA数据，上传到Vulkan前常需要：
+RGB扩展为RGBA、交换通道顺序、预乘alpha，以及为无法blit的格式在CPU上生成mipmap。
+以下函数都是src -> dst的形式，dst可以直接是映射后的暂存缓冲区（staging buffer）：
+函数只顺序写入dst而从不读取dst，这对write-combined的映射内存很重要。
+所有行级函数的row_pitch以字节为单位，为0时视为紧密排列。
+*/
+namespace vulkan::image_convert {
+
+enum class simdLevel {
+    scalar,
+    ssse3,
+    avx2
+};
+
+inline simdLevel detect_simd_level() {
+#ifdef IMAGE_CONVERT_X86
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return simdLevel::avx2;
+    if (__builtin_cpu_supports("ssse3"))
+        return simdLevel::ssse3;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = info[2] & (1 << 9);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+    if (max_leaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5))
+            return simdLevel::avx2;
+    }
+    if (ssse3)
+        return simdLevel::ssse3;
+#endif
+#endif
+    return simdLevel::scalar;
+}
+
+//检测结果只算一次
+inline simdLevel simd_level() {
+    static const simdLevel level = detect_simd_level();
+    return level;
+}
+
+inline const char* simd_level_name(simdLevel level) {
+    switch (level) {
+    case simdLevel::avx2: return "AVX2";
+    case simdLevel::ssse3: return "SSSE3";
+    default: return "scalar";
+    }
+}
+
+//通道顺序，order[i]为目标第i个通道取自源像素的哪个通道
+struct swizzleOrder {
+    uint8_t order[4];
+};
+constexpr swizzleOrder swizzle_rgba_to_bgra = { { 2, 1, 0, 3 } };
+constexpr swizzleOrder swizzle_rgba_to_argb = { { 3, 0, 1, 2 } };
+constexpr swizzleOrder swizzle_rgba_to_abgr = { { 3, 2, 1, 0 } };
+
+//精确的round(x / 255)，x ∈ [0, 255 * 255]
+constexpr uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+//完整mip链（含第0级）在紧密排列时所需的字节数
+inline size_t mip_chain_size_rgba(uint32_t width, uint32_t height, uint32_t* level_count = nullptr) {
+    size_t size = 0;
+    uint32_t levels = 0;
+    while (true) {
+        size += size_t(width) * height * 4;
+        levels++;
+        if (width == 1 && height == 1)
+            break;
+        width = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+    }
+    if (level_count)
+        *level_count = levels;
+    return size;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+//标量实现，也用于处理SIMD循环剩下的尾部
+namespace scalar {
+
+inline void rgb_to_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, uint8_t alpha = 255) {
+    for (size_t i = 0; i < pixel_count; i++) {
+        dst[i * 4] = src[i * 3];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = alpha;
+    }
+}
+
+inline void swizzle_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, swizzleOrder swizzle) {
+    const uint8_t* o = swizzle.order;
+    for (size_t i = 0; i < pixel_count; i++) {
+        const uint8_t* s = src + i * 4;
+        uint8_t* d = dst + i * 4;
+        uint8_t r = s[o[0]], g = s[o[1]], b = s[o[2]], a = s[o[3]];
+        d[0] = r, d[1] = g, d[2] = b, d[3] = a;
+    }
+}
+
+inline void premultiply_alpha_row(const uint8_t* src, uint8_t* dst, size_t pixel_count) {
+    for (size_t i = 0; i < pixel_count; i++) {
+        const uint8_t* s = src + i * 4;
+        uint8_t* d = dst + i * 4;
+        uint32_t a = s[3];
+        d[0] = uint8_t(div255(s[0] * a));
+        d[1] = uint8_t(div255(s[1] * a));
+        d[2] = uint8_t(div255(s[2] * a));
+        d[3] = uint8_t(a);
+    }
+}
+
+//2x2盒式滤波，从第begin个目标像素开始；宽度为奇数时最后一列与前一列合并时夹取坐标
+inline void downsample_rgba_row(const uint8_t* row0, const uint8_t* row1, uint32_t src_width,
+    uint8_t* dst, uint32_t dst_width, uint32_t begin = 0) {
+    for (uint32_t x = begin; x < dst_width; x++) {
+        uint32_t x0 = std::min(x * 2, src_width - 1);
+        uint32_t x1 = std::min(x * 2 + 1, src_width - 1);
+        for (uint32_t c = 0; c < 4; c++)
+            dst[x * 4 + c] = uint8_t((row0[x0 * 4 + c] + row0[x1 * 4 + c] + row1[x0 * 4 + c] + row1[x1 * 4 + c] + 2) >> 2);
+    }
+}
+
+}
+
+#ifdef IMAGE_CONVERT_X86
+//----------------------------------------------------------------------------------------------------------------------
+namespace ssse3 {
+
+IMAGE_CONVERT_TARGET_SSSE3
+inline void rgb_to_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, uint8_t alpha = 255) {
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alpha_mask = _mm_set1_epi32(int32_t(uint32_t(alpha) << 24));
+    size_t i = 0;
+    //每次读16字节但只用其中12字节（4个像素），保证读取不越过源数据末尾
+    for (; i + 6 <= pixel_count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha_mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), v);
+    }
+    scalar::rgb_to_rgba_row(src + i * 3, dst + i * 4, pixel_count - i, alpha);
+}
+
+IMAGE_CONVERT_TARGET_SSSE3
+inline void swizzle_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, swizzleOrder swizzle) {
+    alignas(16) int8_t mask[16];
+    for (int p = 0; p < 4; p++)
+        for (int c = 0; c < 4; c++)
+            mask[p * 4 + c] = int8_t(p * 4 + swizzle.order[c]);
+    const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i*>(mask));
+    size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_shuffle_epi8(v, shuffle));
+    }
+    scalar::swizzle_rgba_row(src + i * 4, dst + i * 4, pixel_count - i, swizzle);
+}
+
+//以下两个函数只用到SSE2，放在这里是为了和上面共用分派
+IMAGE_CONVERT_TARGET_SSSE3
+inline __m128i premultiply_2px(__m128i c, __m128i keep_alpha, __m128i alpha_255, __m128i bias) {
+    //把每个像素的alpha广播到该像素的4个16位通道上，再把alpha通道的乘数换成255
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_or_si128(_mm_and_si128(a, keep_alpha), alpha_255);
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), bias);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+IMAGE_CONVERT_TARGET_SSSE3
+inline void premultiply_alpha_row(const uint8_t* src, uint8_t* dst, size_t pixel_count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i keep_alpha = _mm_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0);
+    const __m128i alpha_255 = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+    const __m128i bias = _mm_set1_epi16(128);
+    size_t i = 0;
+    for (; i + 4 <= pixel_count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i lo = premultiply_2px(_mm_unpacklo_epi8(v, zero), keep_alpha, alpha_255, bias);
+        __m128i hi = premultiply_2px(_mm_unpackhi_epi8(v, zero), keep_alpha, alpha_255, bias);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+    }
+    scalar::premultiply_alpha_row(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+IMAGE_CONVERT_TARGET_SSSE3
+inline void downsample_rgba_row(const uint8_t* row0, const uint8_t* row1, uint32_t src_width,
+    uint8_t* dst, uint32_t dst_width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(2);
+    uint32_t x = 0;
+    //每次处理4个源像素 -> 2个目标像素，只处理两列都在图像内的部分
+    for (; x + 2 <= dst_width && x * 2 + 4 <= src_width; x += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), bias), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), _mm_packus_epi16(sum, zero));
+    }
+    scalar::downsample_rgba_row(row0, row1, src_width, dst, dst_width, x);
+}
+
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+namespace avx2 {
+
+IMAGE_CONVERT_TARGET_AVX2
+inline void rgb_to_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, uint8_t alpha = 255) {
+    const __m256i shuffle = _mm256_setr_epi8(
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha_mask = _mm256_set1_epi32(int32_t(uint32_t(alpha) << 24));
+    size_t i = 0;
+    //pshufb不能跨128位通道，因此两个通道分别读取源数据的第0和第12字节起的16字节
+    for (; i + 10 <= pixel_count; i += 8) {
+        const uint8_t* s = src + i * 3;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 12)), 1);
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha_mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), v);
+    }
+    ssse3::rgb_to_rgba_row(src + i * 3, dst + i * 4, pixel_count - i, alpha);
+}
+
+IMAGE_CONVERT_TARGET_AVX2
+inline void swizzle_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, swizzleOrder swizzle) {
+    alignas(32) int8_t mask[32];
+    for (int p = 0; p < 8; p++)
+        for (int c = 0; c < 4; c++)
+            mask[p * 4 + c] = int8_t(p % 4 * 4 + swizzle.order[c]);
+    const __m256i shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(mask));
+    size_t i = 0;
+    for (; i + 8 <= pixel_count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(v, shuffle));
+    }
+    ssse3::swizzle_rgba_row(src + i * 4, dst + i * 4, pixel_count - i, swizzle);
+}
+
+IMAGE_CONVERT_TARGET_AVX2
+inline __m256i premultiply_4px(__m256i c, __m256i keep_alpha, __m256i alpha_255, __m256i bias) {
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm256_or_si256(_mm256_and_si256(a, keep_alpha), alpha_255);
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c, a), bias);
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+IMAGE_CONVERT_TARGET_AVX2
+inline void premultiply_alpha_row(const uint8_t* src, uint8_t* dst, size_t pixel_count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i keep_alpha = _mm256_setr_epi16(-1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0, -1, -1, -1, 0);
+    const __m256i alpha_255 = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+    const __m256i bias = _mm256_set1_epi16(128);
+    size_t i = 0;
+    //unpack与pack都是按128位通道进行的，一进一出后像素顺序不变
+    for (; i + 8 <= pixel_count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        __m256i lo = premultiply_4px(_mm256_unpacklo_epi8(v, zero), keep_alpha, alpha_255, bias);
+        __m256i hi = premultiply_4px(_mm256_unpackhi_epi8(v, zero), keep_alpha, alpha_255, bias);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_packus_epi16(lo, hi));
+    }
+    ssse3::premultiply_alpha_row(src + i * 4, dst + i * 4, pixel_count - i);
+}
+
+//降采样受内存带宽限制，AVX2版本相比SSE收益很小，直接复用
+using ssse3::downsample_rgba_row;
+
+}
+#endif
+
+//----------------------------------------------------------------------------------------------------------------------
+//按行分派，level默认为运行时检测到的最高指令集
+inline void rgb_to_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, uint8_t alpha = 255, simdLevel level = simd_level()) {
+#ifdef IMAGE_CONVERT_X86
+    if (level == simdLevel::avx2)
+        return avx2::rgb_to_rgba_row(src, dst, pixel_count, alpha);
+    if (level == simdLevel::ssse3)
+        return ssse3::rgb_to_rgba_row(src, dst, pixel_count, alpha);
+#endif
+    scalar::rgb_to_rgba_row(src, dst, pixel_count, alpha);
+}
+
+inline void swizzle_rgba_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, swizzleOrder swizzle, simdLevel level = simd_level()) {
+#ifdef IMAGE_CONVERT_X86
+    if (level == simdLevel::avx2)
+        return avx2::swizzle_rgba_row(src, dst, pixel_count, swizzle);
+    if (level == simdLevel::ssse3)
+        return ssse3::swizzle_rgba_row(src, dst, pixel_count, swizzle);
+#endif
+    scalar::swizzle_rgba_row(src, dst, pixel_count, swizzle);
+}
+
+inline void premultiply_alpha_row(const uint8_t* src, uint8_t* dst, size_t pixel_count, simdLevel level = simd_level()) {
+#ifdef IMAGE_CONVERT_X86
+    if (level == simdLevel::avx2)
+        return avx2::premultiply_alpha_row(src, dst, pixel_count);
+    if (level == simdLevel::ssse3)
+        return ssse3::premultiply_alpha_row(src, dst, pixel_count);
+#endif
+    scalar::premultiply_alpha_row(src, dst, pixel_count);
+}
+
+inline void downsample_rgba_row(const uint8_t* row0, const uint8_t* row1, uint32_t src_width, uint8_t* dst, uint32_t dst_width, simdLevel level = simd_level()) {
+#ifdef IMAGE_CONVERT_X86
+    if (level != simdLevel::scalar)
+        return ssse3::downsample_rgba_row(row0, row1, src_width, dst, dst_width);
+#endif
+    scalar::downsample_rgba_row(row0, row1, src_width, dst, dst_width);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+//整张图像的版本，row_pitch为0时视为紧密排列。dst_row_pitch通常来自VkBufferImageCopy::bufferRowLength或VkSubresourceLayout::rowPitch
+inline void rgb_to_rgba(const uint8_t* src, size_t src_row_pitch, uint8_t* dst, size_t dst_row_pitch,
+    uint32_t width, uint32_t height, uint8_t alpha = 255, simdLevel level = simd_level()) {
+    src_row_pitch = src_row_pitch ? src_row_pitch : size_t(width) * 3;
+    dst_row_pitch = dst_row_pitch ? dst_row_pitch : size_t(width) * 4;
+    //两边都紧密排列时整张图当成一行处理，省掉每行的尾部
+    if (src_row_pitch == size_t(width) * 3 && dst_row_pitch == size_t(width) * 4)
+        return rgb_to_rgba_row(src, dst, size_t(width) * height, alpha, level);
+    for (uint32_t y = 0; y < height; y++)
+        rgb_to_rgba_row(src + y * src_row_pitch, dst + y * dst_row_pitch, width, alpha, level);
+}
+
+inline void swizzle_rgba(const uint8_t* src, size_t src_row_pitch, uint8_t* dst, size_t dst_row_pitch,
+    uint32_t width, uint32_t height, swizzleOrder swizzle, simdLevel level = simd_level()) {
+    size_t tight = size_t(width) * 4;
+    src_row_pitch = src_row_pitch ? src_row_pitch : tight;
+    dst_row_pitch = dst_row_pitch ? dst_row_pitch : tight;
+    if (src_row_pitch == tight && dst_row_pitch == tight)
+        return swizzle_rgba_row(src, dst, size_t(width) * height, swizzle, level);
+    for (uint32_t y = 0; y < height; y++)
+        swizzle_rgba_row(src + y * src_row_pitch, dst + y * dst_row_pitch, width, swizzle, level);
+}
+
+inline void premultiply_alpha(const uint8_t* src, size_t src_row_pitch, uint8_t* dst, size_t dst_row_pitch,
+    uint32_t width, uint32_t height, simdLevel level = simd_level()) {
+    size_t tight = size_t(width) * 4;
+    src_row_pitch = src_row_pitch ? src_row_pitch : tight;
+    dst_row_pitch = dst_row_pitch ? dst_row_pitch : tight;
+    if (src_row_pitch == tight && dst_row_pitch == tight)
+        return premultiply_alpha_row(src, dst, size_t(width) * height, level);
+    for (uint32_t y = 0; y < height; y++)
+        premultiply_alpha_row(src + y * src_row_pitch, dst + y * dst_row_pitch, width, level);
+}
+
+//生成下一级mip，目标尺寸为max(width / 2, 1) x max(height / 2, 1)
+inline void downsample_rgba(const uint8_t* src, size_t src_row_pitch, uint32_t width, uint32_t height,
+    uint8_t* dst, size_t dst_row_pitch, simdLevel level = simd_level()) {
+    uint32_t dst_width = std::max(width >> 1, 1u);
+    uint32_t dst_height = std::max(height >> 1, 1u);
+    src_row_pitch = src_row_pitch ? src_row_pitch : size_t(width) * 4;
+    dst_row_pitch = dst_row_pitch ? dst_row_pitch : size_t(dst_width) * 4;
+    for (uint32_t y = 0; y < dst_height; y++) {
+        const uint8_t* row0 = src + std::min(y * 2, height - 1) * src_row_pitch;
+        const uint8_t* row1 = src + std::min(y * 2 + 1, height - 1) * src_row_pitch;
+        downsample_rgba_row(row0, row1, width, dst + y * dst_row_pitch, dst_width, level);
+    }
+}
+
+/*
+把第0级拷贝到dst，然后逐级生成整个mip链，各级在dst中紧密相连（所需大小见mip_chain_size_rgba(...)）。
+除第0级外，每一级都以dst中上一级为源。注意这会读回dst，若dst是write-combined的映射内存，
+应先在普通内存中生成，或只对不在映射内存中的缓冲调用此函数。
+level_offsets非空时写入各级在dst中的偏移量，可直接填进VkBufferImageCopy::bufferOffset。
+*/
+inline uint32_t generate_mip_chain_rgba(const uint8_t* src, size_t src_row_pitch, uint32_t width, uint32_t height,
+    uint8_t* dst, size_t* level_offsets = nullptr, simdLevel level = simd_level()) {
+    size_t tight = size_t(width) * 4;
+    src_row_pitch = src_row_pitch ? src_row_pitch : tight;
+    for (uint32_t y = 0; y < height; y++)
+        std::memcpy(dst + y * tight, src + y * src_row_pitch, tight);
+    size_t offset = 0;
+    uint32_t level_count = 1;
+    if (level_offsets)
+        level_offsets[0] = 0;
+    while (width > 1 || height > 1) {
+        size_t next = offset + size_t(width) * height * 4;
+        downsample_rgba(dst + offset, 0, width, height, dst + next, 0, level);
+        width = std::max(width >> 1, 1u);
+        height = std::max(height >> 1, 1u);
+        offset = next;
+        if (level_offsets)
+            level_offsets[level_count] = offset;
+        level_count++;
+    }
+    return level_count;
+}
+
+}
@@ -0,0 +1,277 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace vulkan {
+
+/*
+依赖计数器：每个挂在它上面的任务在提交时+1、完成时-1，归零即表示这批任务全部完成。
+任务之间的依赖用计数器表达：后续任务在开头wait(...)前置任务的计数器，等待期间该线程会去执行别的任务，而不是阻塞。
+*/
+class jobCounter {
+    friend class jobSystem;
+    std::atomic<uint32_t> count = 0;
+public:
+    jobCounter() = default;
+    jobCounter(jobCounter&&) = delete;
+    bool done() const { return count.load(std::memory_order_acquire) == 0; }
+};
+
+/*
+工作窃取（work-stealing）任务调度器。
+每个线程（包括创建调度器的线程，即索引0的主线程）各有一个Chase-Lev双端队列：
+所有者在底部压入和弹出（LIFO，缓存友好），空闲线程从其他线程队列的顶部窃取（FIFO）。
+任务对象从提交线程自己的环形池中取得，提交与执行都不会分配堆内存。
+只有调度器自己的线程能提交任务；在其他线程上调用run(...)时任务会直接在调用线程上执行。
+*/
+class jobSystem {
+public:
+    static constexpr uint32_t queue_capacity = 1024; //须为2的幂
+    static constexpr size_t job_storage_size = 48; //可调用对象（含捕获）的最大字节数
+private:
+    struct job {
+        void(*invoke)(job&) = nullptr;
+        jobCounter* counter = nullptr;
+        std::atomic<bool> busy = false;
+        alignas(std::max_align_t) std::byte storage[job_storage_size];
+    };
+
+    //Chase-Lev双端队列，内存序参考Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models"
+    class workStealingQueue {
+        static constexpr int64_t mask = queue_capacity - 1;
+        alignas(64) std::atomic<int64_t> top = 0;
+        alignas(64) std::atomic<int64_t> bottom = 0;
+        std::atomic<job*> entries[queue_capacity] = {};
+    public:
+        //仅所有者调用
+        bool push(job* pJob) {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= int64_t(queue_capacity))
+                return false;
+            entries[b & mask].store(pJob, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_release);
+            return true;
+        }
+        //仅所有者调用
+        job* pop() {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            job* pJob = entries[b & mask].load(std::memory_order_relaxed);
+            if (t == b) {
+                //只剩最后一个，和窃取者竞争
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    pJob = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return pJob;
+        }
+        //任意线程调用
+        job* steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b)
+                return nullptr;
+            job* pJob = entries[t & mask].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return pJob;
+        }
+    };
+
+    struct alignas(64) worker {
+        workStealingQueue queue;
+        std::unique_ptr<job[]> job_pool = std::make_unique<job[]>(queue_capacity);
+        uint32_t next_job = 0;
+        uint32_t random_state = 0;
+    };
+
+    std::unique_ptr<worker[]> workers;
+    std::vector<std::thread> threads;
+    uint32_t worker_count = 0;
+    std::atomic<bool> stop = false;
+    //用于让空闲线程休眠：每次提交任务时递增，空闲线程等待其变化
+    std::atomic<uint32_t> generation = 0;
+    std::atomic<uint32_t> sleeping_count = 0;
+
+    static jobSystem*& current_owner() {
+        thread_local jobSystem* owner = nullptr;
+        return owner;
+    }
+    static uint32_t& current_index() {
+        thread_local uint32_t index = 0;
+        return index;
+    }
+
+    static void execute(job& j) {
+        j.invoke(j);
+        jobCounter* counter = j.counter;
+        j.busy.store(false, std::memory_order_release);
+        if (counter)
+            counter->count.fetch_sub(1, std::memory_order_acq_rel);
+    }
+    job* find_job(uint32_t self) {
+        if (job* pJob = workers[self].queue.pop())
+            return pJob;
+        //xorshift选一个随机起点，避免所有空闲线程都去窃取同一个队列
+        uint32_t& s = workers[self].random_state;
+        s ^= s << 13, s ^= s >> 17, s ^= s << 5;
+        for (uint32_t i = 0; i < worker_count; i++) {
+            uint32_t victim = (s + i) % worker_count;
+            if (victim == self)
+                continue;
+            if (job* pJob = workers[victim].queue.steal())
+                return pJob;
+        }
+        return nullptr;
+    }
+    //执行一个任务，没有任务可执行时返回false
+    bool execute_one(uint32_t self) {
+        if (job* pJob = find_job(self)) {
+            execute(*pJob);
+            return true;
+        }
+        return false;
+    }
+    void worker_loop(uint32_t index) {
+        current_owner() = this;
+        current_index() = index;
+        while (!stop.load(std::memory_order_acquire)) {
+            if (execute_one(index))
+                continue;
+            //先自旋一会儿，帧内的任务往往一波接一波，马上休眠反而增加唤醒延迟
+            bool found = false;
+            for (int i = 0; i < 64 && !found; i++) {
+                std::this_thread::yield();
+                found = execute_one(index);
+            }
+            if (found)
+                continue;
+            //先读generation再检查一次队列，这样在此之后提交的任务一定会改变generation，不会错过唤醒
+            uint32_t observed = generation.load(std::memory_order_seq_cst);
+            if (execute_one(index))
+                continue;
+            if (stop.load(std::memory_order_acquire))
+                break;
+            sleeping_count.fetch_add(1, std::memory_order_seq_cst);
+            generation.wait(observed, std::memory_order_seq_cst);
+            sleeping_count.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+    void wake_one() {
+        generation.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping_count.load(std::memory_order_seq_cst))
+            generation.notify_one();
+    }
+public:
+    //thread_count包括调用线程，为0时使用硬件线程数
+    jobSystem(uint32_t thread_count = 0) {
+        worker_count = thread_count ? thread_count : std::max(std::thread::hardware_concurrency(), 1u);
+        workers = std::make_unique<worker[]>(worker_count);
+        for (uint32_t i = 0; i < worker_count; i++)
+            workers[i].random_state = i * 2654435761u + 1;
+        current_owner() = this;
+        current_index() = 0;
+        threads.reserve(worker_count - 1);
+        for (uint32_t i = 1; i < worker_count; i++)
+            threads.emplace_back(&jobSystem::worker_loop, this, i);
+    }
+    jobSystem(jobSystem&&) = delete;
+    ~jobSystem() {
+        //先把主线程队列里剩下的任务做完
+        while (execute_one(0));
+        stop.store(true, std::memory_order_release);
+        generation.fetch_add(1, std::memory_order_seq_cst);
+        generation.notify_all();
+        for (auto& i : threads)
+            i.join();
+        if (current_owner() == this)
+            current_owner() = nullptr;
+    }
+    //Getter
+    uint32_t thread_count() const { return worker_count; }
+    //当前线程在调度器中的索引，可用来索引每线程的数据；不属于本调度器的线程返回UINT32_MAX
+    uint32_t thread_index() const { return current_owner() == this ? current_index() : UINT32_MAX; }
+    //Non-const Function
+    /*
+    提交任务，counter非空时任务完成前counter不会归零。
+    func的大小不能超过job_storage_size，较大的数据请以引用或指针捕获。
+    */
+    template<typename F>
+    void run(F&& func, jobCounter* counter = nullptr) {
+        using function_t = std::decay_t<F>;
+        static_assert(sizeof(function_t) <= job_storage_size, "Job function object is too large!");
+        static_assert(alignof(function_t) <= alignof(std::max_align_t));
+        if (current_owner() != this) {
+            func();
+            return;
+        }
+        uint32_t self = current_index();
+        worker& w = workers[self];
+        //环形池转了一圈又回到未完成的任务时跳过它（它可能正在本线程的调用栈上执行，不能等它）
+        job* pJob = nullptr;
+        for (uint32_t i = 0; i < queue_capacity && !pJob; i++) {
+            job& j = w.job_pool[w.next_job++ & (queue_capacity - 1)];
+            if (!j.busy.load(std::memory_order_acquire))
+                pJob = &j;
+        }
+        //池中的任务全都未完成，直接执行
+        if (!pJob) {
+            func();
+            return;
+        }
+        new(pJob->storage) function_t(std::forward<F>(func));
+        pJob->invoke = [](job& j) {
+            function_t* pFunction = std::launder(reinterpret_cast<function_t*>(j.storage));
+            (*pFunction)();
+            pFunction->~function_t();
+        };
+        pJob->counter = counter;
+        pJob->busy.store(true, std::memory_order_relaxed);
+        if (counter)
+            counter->count.fetch_add(1, std::memory_order_relaxed);
+        //队列满时直接执行
+        if (!w.queue.push(pJob)) {
+            execute(*pJob);
+            return;
+        }
+        wake_one();
+    }
+    /*
+    把[0, count)按batch_size分成若干段并行执行，func的签名为void(uint32_t first, uint32_t count)。
+    func以引用方式被各任务共享，须在counter归零前保持有效。
+    */
+    template<typename F>
+    void parallel_for(uint32_t count, uint32_t batch_size, F& func, jobCounter& counter) {
+        batch_size = std::max(batch_size, 1u);
+        for (uint32_t first = 0; first < count; first += batch_size) {
+            uint32_t range_count = std::min(batch_size, count - first);
+            run([&func, first, range_count] { func(first, range_count); }, &counter);
+        }
+    }
+    //等待counter归零，期间执行其他任务；不属于本调度器的线程只会自旋等待
+    void wait(const jobCounter& counter) {
+        bool is_worker = current_owner() == this;
+        while (!counter.done()) {
+            if (!is_worker || !execute_one(current_index()))
+                std::this_thread::yield();
+        }
+    }
+};
+
+}
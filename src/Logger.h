@@ -0,0 +1,277 @@
+#pragma once
+#include "MpscQueue.h"
+#include <chrono>
+#include <concepts>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+namespace vulkan {
+
+inline auto& outStream = std::cout;//不是constexpr，因为std::cout具有外部链接
+
+enum class logLevel : uint8_t {
+    debug,
+    info,
+    warning,
+    error,
+    off
+};
+
+//低于此等级的日志在编译期即被去掉；可在包含本文件前定义LOG_MIN_LEVEL为logLevel的枚举项名称
+#ifndef LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_MIN_LEVEL info
+#else
+#define LOG_MIN_LEVEL debug
+#endif
+#endif
+constexpr logLevel log_min_level = logLevel::LOG_MIN_LEVEL;
+
+//每个调用处一个，限制同一处每秒最多输出max_per_second条，多出的只计数，在下一条输出时一并提示
+class rateLimiter {
+    static constexpr uint32_t max_per_second = 16;
+    std::atomic<int64_t> window = -1;
+    std::atomic<uint32_t> count = 0;
+    std::atomic<uint32_t> suppressed = 0;
+public:
+    bool allow(uint32_t& suppressed_before) {
+        int64_t now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t last = window.load(std::memory_order_relaxed);
+        if (now != last && window.compare_exchange_strong(last, now, std::memory_order_relaxed))
+            count.store(0, std::memory_order_relaxed);
+        if (count.fetch_add(1, std::memory_order_relaxed) >= max_per_second) {
+            suppressed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        suppressed_before = suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+};
+
+/*
+异步日志。
+调用线程只把格式字符串（须为字面量）和参数的值拷进无锁环形队列里的一条定长记录，不格式化、不做I/O；
+后台线程取出记录，调用std::vformat_to(...)格式化后写入outStream。
+字符串参数会被拷进记录（过长时截断），因此可以传入临时字符串；其余参数须可平凡拷贝。
+队列满时新日志被丢弃并计数，不会阻塞调用线程。
+不能截断或丢弃的日志（如验证层的消息）用log_sync(...)在调用线程上同步写出。
+*/
+class asyncLogger {
+public:
+    static constexpr uint32_t queue_capacity = 1024;
+    static constexpr size_t record_size = 1024;
+private:
+    struct record;
+    using format_function_t = void(*)(const record&, std::string&);
+    struct record {
+        format_function_t format;
+        std::string_view format_string;
+        uint32_t suppressed;
+        logLevel level;
+        alignas(8) std::byte args[record_size - sizeof(format_function_t) - sizeof(std::string_view) - 8];
+    };
+
+    template<typename T>
+    static constexpr bool is_string_arg = std::convertible_to<const T&, std::string_view>;
+    //按顺序把参数写进记录；字符串写成2字节长度加字符，长度受剩余空间限制
+    class argWriter {
+        std::byte* p;
+        size_t string_budget;
+    public:
+        argWriter(std::byte* p, size_t string_budget) :p(p), string_budget(string_budget) {}
+        template<typename T>
+        void write(const T& value) {
+            if constexpr (is_string_arg<T>) {
+                std::string_view string = value;
+                uint16_t length = uint16_t(std::min(string.size(), string_budget));
+                string_budget -= length;
+                std::memcpy(p, &length, sizeof length);
+                std::memcpy(p + sizeof length, string.data(), length);
+                p += sizeof length + length;
+            }
+            else {
+                static_assert(std::is_trivially_copyable_v<T>, "Log arguments must be strings or trivially copyable!");
+                std::memcpy(p, &value, sizeof(T));
+                p += sizeof(T);
+            }
+        }
+    };
+    class argReader {
+        const std::byte* p;
+    public:
+        argReader(const std::byte* p) :p(p) {}
+        template<typename T>
+        auto read() {
+            if constexpr (is_string_arg<T>) {
+                uint16_t length;
+                std::memcpy(&length, p, sizeof length);
+                std::string_view string(reinterpret_cast<const char*>(p + sizeof length), length);
+                p += sizeof length + length;
+                return string;
+            }
+            else {
+                T value;
+                std::memcpy(&value, p, sizeof(T));
+                p += sizeof(T);
+                return value;
+            }
+        }
+    };
+    //非字符串参数与字符串长度所占的字节数，余下的空间留给字符串内容
+    template<typename... Args>
+    static constexpr size_t fixed_args_size = ((is_string_arg<Args> ? sizeof(uint16_t) : sizeof(Args)) + ... + 0);
+
+    //在后台线程上由记录还原参数并格式化
+    template<typename... Args>
+    static void format_record(const record& r, std::string& out) {
+        argReader reader(r.args);
+        //花括号初始化保证按从左到右的顺序读取
+        std::tuple<decltype(reader.read<Args>())...> values{ reader.read<Args>()... };
+        std::apply([&](auto&... value) {
+            std::vformat_to(std::back_inserter(out), r.format_string, std::make_format_args(value...));
+        }, values);
+    }
+
+    mpscQueue<record, queue_capacity> records;
+    std::thread thread;
+    std::atomic<bool> stop = false;
+    std::atomic<uint32_t> signal = 0;
+    std::atomic<uint32_t> sleeping = 0;
+    std::atomic<uint64_t> submitted_count = 0;
+    std::atomic<uint64_t> written_count = 0;
+    std::atomic<uint64_t> dropped_count = 0;
+    //后台线程与log_sync(...)都向outStream写，以此保证每条日志完整
+    std::mutex output_mutex;
+
+    void notify() {
+        signal.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst))
+            signal.notify_one();
+    }
+    void writer_loop() {
+        //复用同一个字符串，稳定后格式化不再分配内存
+        std::string text;
+        text.reserve(record_size * 4);
+        uint64_t reported_dropped = 0;
+        while (true) {
+            uint32_t observed = signal.load(std::memory_order_seq_cst);
+            bool any = false;
+            while (record* r = records.front()) {
+                text.clear();
+                if (r->suppressed)
+                    std::format_to(std::back_inserter(text), "({} similar message(s) suppressed)\n", r->suppressed);
+                r->format(*r, text);
+                records.pop_front();
+                std::lock_guard lock(output_mutex);
+                outStream.write(text.data(), text.size());
+                written_count.fetch_add(1, std::memory_order_release);
+                any = true;
+            }
+            if (uint64_t dropped = dropped_count.load(std::memory_order_relaxed); dropped != reported_dropped) {
+                std::lock_guard lock(output_mutex);
+                outStream << std::format("[ asyncLogger ] WARNING\n{} message(s) dropped because the log queue was full!\n", dropped - reported_dropped);
+                reported_dropped = dropped;
+            }
+            if (any) {
+                {
+                    std::lock_guard lock(output_mutex);
+                    outStream.flush();
+                }
+                written_count.notify_all();
+                continue;
+            }
+            if (stop.load(std::memory_order_acquire))
+                break;
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            signal.wait(observed, std::memory_order_seq_cst);
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+public:
+    asyncLogger() {
+        thread = std::thread(&asyncLogger::writer_loop, this);
+    }
+    asyncLogger(asyncLogger&&) = delete;
+    ~asyncLogger() {
+        stop.store(true, std::memory_order_release);
+        notify();
+        thread.join();
+    }
+    //Const Function
+    //阻塞至此前提交的日志全部写出，用于abort()之前或需要与其他输出保持顺序时
+    void flush() {
+        uint64_t target = submitted_count.load(std::memory_order_acquire);
+        notify();
+        for (uint64_t written; (written = written_count.load(std::memory_order_acquire)) < target;)
+            written_count.wait(written, std::memory_order_acquire);
+    }
+    //Non-const Function
+    /*
+    在调用线程上格式化并立即写出，不截断、不限频、不会因队列满而丢弃，代价是格式化的堆分配和I/O都在调用线程上。
+    先等此前提交的异步日志写完，因此与本线程先前的日志保持顺序。通常经由LogErrorSync(...)等宏调用。
+    */
+    template<typename... Args>
+    void log_sync(std::format_string<Args...> format, Args&&... args) {
+        std::string text = std::vformat(format.get(), std::make_format_args(args...));
+        flush();
+        std::lock_guard lock(output_mutex);
+        outStream.write(text.data(), text.size());
+        outStream.flush();
+    }
+    //通常经由LogError(...)等宏调用，以便在编译期过滤等级并为每个调用处生成一个rateLimiter
+    template<logLevel level, typename... Args>
+    void log(rateLimiter& limiter, std::format_string<Args...> format, Args&&... args) {
+        static constexpr size_t fixed_size = fixed_args_size<std::decay_t<Args>...>;
+        static_assert(fixed_size <= sizeof(record::args), "Too many log arguments!");
+        uint32_t suppressed;
+        if (!limiter.allow(suppressed))
+            return;
+        bool pushed = records.emplace([&](record& r) {
+            r.format = &format_record<std::decay_t<Args>...>;
+            r.format_string = format.get();
+            r.suppressed = suppressed;
+            r.level = level;
+            argWriter writer(r.args, sizeof(record::args) - fixed_size);
+            (writer.write<std::decay_t<Args>>(args), ...);
+        });
+        if (!pushed) {
+            dropped_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        submitted_count.fetch_add(1, std::memory_order_release);
+        notify();
+    }
+};
+
+//须在其他全局对象（如graphics_base）之前定义，使其最后被析构，以便那些对象在析构时仍能输出日志
+inline asyncLogger logger;
+
+#define LogMessage(level, ...) \
+    do { \
+        if constexpr (vulkan::logLevel::level >= vulkan::log_min_level) { \
+            static vulkan::rateLimiter rate_limiter; \
+            vulkan::logger.log<vulkan::logLevel::level>(rate_limiter, __VA_ARGS__); \
+        } \
+    } while (0)
+#define LogDebug(...) LogMessage(debug, __VA_ARGS__)
+#define LogInfo(...) LogMessage(info, __VA_ARGS__)
+#define LogWarning(...) LogMessage(warning, __VA_ARGS__)
+#define LogError(...) LogMessage(error, __VA_ARGS__)
+//同步输出，见asyncLogger::log_sync(...)
+#define LogMessageSync(level, ...) \
+    do { \
+        if constexpr (vulkan::logLevel::level >= vulkan::log_min_level) \
+            vulkan::logger.log_sync(__VA_ARGS__); \
+    } while (0)
+#define LogWarningSync(...) LogMessageSync(warning, __VA_ARGS__)
+#define LogErrorSync(...) LogMessageSync(error, __VA_ARGS__)
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace vulkan {
+
+/*
+有界、无锁的多生产者单消费者队列（基于Dmitry Vyukov的有界MPMC队列，消费端简化为单线程）。
+每个格子带一个序号：序号等于写入位置时可写，等于写入位置+1时可读，读完后加上capacity留给下一圈。
+生产者之间只竞争一次CAS，消费者不需要任何原子读改写操作。
+*/
+template<typename T, uint32_t capacity>
+class mpscQueue {
+    static_assert(capacity && (capacity & (capacity - 1)) == 0, "Capacity must be a power of 2!");
+    static constexpr uint32_t mask = capacity - 1;
+    struct cell {
+        std::atomic<uint32_t> sequence;
+        T data;
+    };
+    std::unique_ptr<cell[]> cells = std::make_unique<cell[]>(capacity);
+    alignas(64) std::atomic<uint32_t> enqueue_position = 0;
+    alignas(64) uint32_t dequeue_position = 0;
+public:
+    mpscQueue() {
+        for (uint32_t i = 0; i < capacity; i++)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mpscQueue(mpscQueue&&) = delete;
+    //任意线程调用，队列满时返回false
+    bool push(const T& value) {
+        uint32_t position = enqueue_position.load(std::memory_order_relaxed);
+        cell* pCell;
+        while (true) {
+            pCell = &cells[position & mask];
+            int32_t diff = int32_t(pCell->sequence.load(std::memory_order_acquire) - position);
+            if (diff == 0) {
+                if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                position = enqueue_position.load(std::memory_order_relaxed);
+        }
+        pCell->data = value;
+        pCell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    //同push(...)，但直接调用fill(T&)在队列的格子里构造数据，省去一次拷贝，适合较大的T
+    template<typename F>
+    bool emplace(F&& fill) {
+        uint32_t position = enqueue_position.load(std::memory_order_relaxed);
+        cell* pCell;
+        while (true) {
+            pCell = &cells[position & mask];
+            int32_t diff = int32_t(pCell->sequence.load(std::memory_order_acquire) - position);
+            if (diff == 0) {
+                if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                position = enqueue_position.load(std::memory_order_relaxed);
+        }
+        fill(pCell->data);
+        pCell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+    //仅消费者线程调用，队列空时返回false
+    bool pop(T& value) {
+        cell& c = cells[dequeue_position & mask];
+        if (c.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+            return false;
+        value = c.data;
+        c.sequence.store(dequeue_position + capacity, std::memory_order_release);
+        dequeue_position++;
+        return true;
+    }
+    //仅消费者线程调用，不出队，直接访问队首元素，用完后调用pop_front()
+    T* front() {
+        cell& c = cells[dequeue_position & mask];
+        if (c.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+            return nullptr;
+        return &c.data;
+    }
+    void pop_front() {
+        cells[dequeue_position & mask].sequence.store(dequeue_position + capacity, std::memory_order_release);
+        dequeue_position++;
+    }
+};
+
+}
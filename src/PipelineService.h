@@ -0,0 +1,283 @@
+#pragma once
+#include "VKBase.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <unordered_set>
+
+namespace vulkan {
+
+/*
+一条管线的描述。
+name是预热列表中的键，须在各次运行之间保持不变。
+create在工作线程上调用，须以给定的管线缓存创建管线；它引用的着色器、管线布局、渲染通道等须在编译完成前保持有效。
+*/
+struct pipelineDescription {
+    std::string name;
+    std::function<VkResult(pipeline&, VkPipelineCache)> create;
+};
+
+//从SPIR-V文件创建计算管线的描述，着色器模块在管线创建后即销毁
+inline pipelineDescription compute_pipeline_description(std::string name, std::string shader_path, VkPipelineLayout layout) {
+    return {
+        std::move(name),
+        [shader_path = std::move(shader_path), layout](pipeline& target, VkPipelineCache cache) -> VkResult {
+            shaderModule module;
+            if (VkResult result = module.create(shader_path.c_str()))
+                return result;
+            VkComputePipelineCreateInfo createInfo = {
+                .stage = module.stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT),
+                .layout = layout
+            };
+            return target.create(createInfo, cache);
+        }
+    };
+}
+
+/*
+管线编译服务：把管线的创建作为任务提交给jobSystem，在各工作线程上并行编译，所有管线共用一个VkPipelineCache。
+1.启动时从cache_path读取上次保存的缓存数据（设备不匹配时丢弃），从warm_up_path读取上次运行实际用到的管线名；
+2.add(...)登记管线并返回句柄，compile_warm_up()只编译预热列表中的管线，compile_all()编译全部（预热列表中的先提交），
+  未提交的管线在首次get(...)或wait(...)时才编译；
+3.渲染时以get(...)取管线，尚未编译完成时返回VK_NULL_HANDLE而不阻塞，因此可以先用已就绪的管线开始渲染，必须用到时再wait(...)；
+4.退出前调用save()，写回缓存数据，并把本次经get(...)或wait(...)取得过的管线名写入预热列表，下次运行恰好预热这些管线。
+除编译任务外，所有成员函数须在同一线程上调用（一般是主线程），且jobSystem须比本对象存在得久。
+*/
+class pipelineService {
+public:
+    using pipelineHandle = uint32_t;
+    static constexpr pipelineHandle invalid_pipeline = UINT32_MAX;
+private:
+    enum state : uint32_t {
+        pending,
+        compiling,
+        ready,
+        failed
+    };
+    struct entry {
+        pipelineDescription description;
+        pipeline handle;
+        std::atomic<uint32_t> state = pending;
+        bool warm = false; //出现在上次运行的预热列表中
+        bool used = false;
+        jobCounter counter;
+    };
+    jobSystem* jobs = nullptr;
+    pipelineCache cache;
+    std::string cache_path;
+    std::string warm_up_path;
+    std::unordered_set<std::string> warm_up_names;
+    //deque使已登记管线的地址在登记新管线时不变，编译任务以指针访问
+    std::deque<entry> entries;
+    std::atomic<uint32_t> ready_count = 0;
+    std::atomic<uint32_t> failed_count = 0;
+    std::atomic<uint64_t> compile_nanoseconds = 0; //各线程上编译耗时之和
+
+    static void build(entry& e, VkPipelineCache cache, pipelineService& service) {
+        auto begin = std::chrono::steady_clock::now();
+        VkResult result = e.description.create(e.handle, cache);
+        service.compile_nanoseconds.fetch_add(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count(), std::memory_order_relaxed);
+        if (result) {
+            LogError("[ pipelineService ] ERROR\nFailed to compile the pipeline {}!\nError code: {}\n", e.description.name, int32_t(result));
+            service.failed_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+            service.ready_count.fetch_add(1, std::memory_order_relaxed);
+        e.state.store(result ? failed : ready, std::memory_order_release);
+    }
+    //由pending改为compiling成功时返回true，即由调用者负责编译
+    static bool claim(entry& e) {
+        uint32_t expected = pending;
+        return e.state.compare_exchange_strong(expected, compiling, std::memory_order_acq_rel);
+    }
+    void submit(entry& e) {
+        if (claim(e))
+            jobs->run([&e, this] { build(e, cache, *this); }, &e.counter);
+    }
+    //与VkPipelineCacheHeaderVersionOne比较，驱动版本更新后缓存自然作废，读到别的设备的缓存时也不会交给驱动
+    static bool cache_data_compatible(std::span<const uint8_t> data) {
+        VkPipelineCacheHeaderVersionOne header;
+        if (data.size() < sizeof header)
+            return false;
+        std::memcpy(&header, data.data(), sizeof header);
+        const VkPhysicalDeviceProperties& properties = graphics_base.physical_device_properties;
+        return header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+            header.vendorID == properties.vendorID &&
+            header.deviceID == properties.deviceID &&
+            !std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    }
+    std::vector<uint8_t> load_cache_data() const {
+        std::vector<uint8_t> data;
+        std::ifstream file(cache_path, std::ios::ate | std::ios::binary);
+        if (!file)
+            return data;
+        data.resize(size_t(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+        if (!file || !cache_data_compatible(data)) {
+            LogWarning("[ pipelineService ] WARNING\nIgnored the incompatible pipeline cache {}!\n", cache_path);
+            data.clear();
+        }
+        return data;
+    }
+    void load_warm_up_list() {
+        std::ifstream file(warm_up_path);
+        for (std::string line; std::getline(file, line);)
+            if (line.size())
+                warm_up_names.insert(std::move(line));
+    }
+public:
+    pipelineService() = default;
+    pipelineService(jobSystem& jobs, const char* cache_path = nullptr, const char* warm_up_path = nullptr) {
+        create(jobs, cache_path, warm_up_path);
+    }
+    pipelineService(pipelineService&&) = delete;
+    ~pipelineService() {
+        wait_all();
+    }
+    //Getter
+    VkPipelineCache get_cache() const { return cache; }
+    uint32_t pipeline_count() const { return uint32_t(entries.size()); }
+    uint32_t ready_pipeline_count() const { return ready_count.load(std::memory_order_relaxed); }
+    uint32_t failed_pipeline_count() const { return failed_count.load(std::memory_order_relaxed); }
+    uint32_t warm_up_count() const { return uint32_t(warm_up_names.size()); }
+    //各线程上编译耗时之和，与实际经过的时间比较即可知并行的效果
+    double compile_seconds() const { return compile_nanoseconds.load(std::memory_order_relaxed) / 1e9; }
+    //Const Function
+    bool is_ready(pipelineHandle handle) const {
+        return entries[handle].state.load(std::memory_order_acquire) == ready;
+    }
+    //Non-const Function
+    //两个路径均可为nullptr，此时不读写相应的文件
+    result_t create(jobSystem& jobs, const char* cache_path = nullptr, const char* warm_up_path = nullptr) {
+        this->jobs = &jobs;
+        this->cache_path = cache_path ? cache_path : "";
+        this->warm_up_path = warm_up_path ? warm_up_path : "";
+        std::vector<uint8_t> initial_data;
+        if (cache_path)
+            initial_data = load_cache_data();
+        if (warm_up_path)
+            load_warm_up_list();
+        VkPipelineCacheCreateInfo createInfo = {
+            .initialDataSize = initial_data.size(),
+            .pInitialData = initial_data.data()
+        };
+        VkResult result = cache.create(createInfo);
+        if (result && initial_data.size()) {
+            //有的驱动对损坏的数据返回错误而非忽略，退回到空缓存
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            result = cache.create(createInfo);
+        }
+        if (result)
+            return result;
+        LogInfo("[ pipelineService ]\nPipeline cache: {} byte(s) loaded, {} pipeline(s) to warm up\n",
+            initial_data.size(), warm_up_names.size());
+        return VK_SUCCESS;
+    }
+    pipelineHandle add(pipelineDescription description) {
+        entry& e = entries.emplace_back();
+        e.warm = warm_up_names.contains(description.name);
+        e.description = std::move(description);
+        return pipelineHandle(entries.size() - 1);
+    }
+    //提交预热列表中的管线，其余的在首次使用时编译
+    void compile_warm_up() {
+        for (auto& i : entries)
+            if (i.warm)
+                submit(i);
+    }
+    //提交全部管线，预热列表中的先提交
+    void compile_all() {
+        compile_warm_up();
+        for (auto& i : entries)
+            submit(i);
+    }
+    //返回已编译好的管线，否则返回VK_NULL_HANDLE并（若尚未提交）提交编译，不会阻塞
+    VkPipeline get(pipelineHandle handle) {
+        entry& e = entries[handle];
+        e.used = true;
+        uint32_t s = e.state.load(std::memory_order_acquire);
+        if (s == ready)
+            return e.handle;
+        if (s == pending)
+            submit(e);
+        return VK_NULL_HANDLE;
+    }
+    //阻塞至管线编译完成，未提交的在当前线程上直接编译，等待期间当前线程会执行其他任务；编译失败时返回VK_NULL_HANDLE
+    VkPipeline wait(pipelineHandle handle) {
+        entry& e = entries[handle];
+        e.used = true;
+        if (claim(e))
+            build(e, cache, *this);
+        else
+            jobs->wait(e.counter);
+        return e.state.load(std::memory_order_acquire) == ready ? VkPipeline(e.handle) : VK_NULL_HANDLE;
+    }
+    void wait_warm_up() {
+        for (auto& i : entries)
+            if (i.warm)
+                jobs->wait(i.counter);
+    }
+    void wait_all() {
+        for (auto& i : entries)
+            jobs->wait(i.counter);
+    }
+    //写回缓存数据和本次用到的管线名，先写临时文件再替换，中途退出不会留下半个文件
+    result_t save() {
+        if (entries.empty())
+            return VK_SUCCESS;
+        wait_all();
+        if (cache_path.size()) {
+            std::vector<uint8_t> data;
+            if (VkResult result = cache.get_data(data))
+                return result;
+            std::string temporary_path = cache_path + ".tmp";
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            file.close();
+            if (!file) {
+                LogError("[ pipelineService ] ERROR\nFailed to write the pipeline cache {}!\n", temporary_path);
+                return VK_RESULT_MAX_ENUM;
+            }
+            //std::rename(...)在Windows上不能替换已存在的文件
+            std::error_code error;
+            std::filesystem::rename(temporary_path, cache_path, error);
+            if (error) {
+                LogError("[ pipelineService ] ERROR\nFailed to replace the pipeline cache {}!\nError: {}\n", cache_path, error.message());
+                return VK_RESULT_MAX_ENUM;
+            }
+        }
+        uint32_t used_count = 0;
+        if (warm_up_path.size()) {
+            std::string temporary_path = warm_up_path + ".tmp";
+            std::ofstream file(temporary_path, std::ios::trunc);
+            for (auto& i : entries)
+                if (i.used) {
+                    file << i.description.name << '\n';
+                    used_count++;
+                }
+            file.close();
+            if (!file) {
+                LogError("[ pipelineService ] ERROR\nFailed to write the pipeline warm-up list {}!\n", temporary_path);
+                return VK_RESULT_MAX_ENUM;
+            }
+            std::error_code error;
+            std::filesystem::rename(temporary_path, warm_up_path, error);
+            if (error) {
+                LogError("[ pipelineService ] ERROR\nFailed to replace the pipeline warm-up list {}!\nError: {}\n", warm_up_path, error.message());
+                return VK_RESULT_MAX_ENUM;
+            }
+        }
+        LogInfo("[ pipelineService ]\n{} of {} pipeline(s) used, {} failed, {:.3f} s spent compiling across threads\n",
+            used_count, entries.size(), failed_pipeline_count(), compile_seconds());
+        return VK_SUCCESS;
+    }
+};
+
+}
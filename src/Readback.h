@@ -0,0 +1,323 @@
+#pragma once
+#include "VKBase.h"
+#include "MpscQueue.h"
+#include "ImageConvert.h"
+#include <stb_image_write.h>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+namespace vulkan {
+
+enum class readbackFileFormat : uint8_t {
+    raw, //所有帧依次写进同一个文件，RGBA8紧密排列，可直接交给ffmpeg -f rawvideo -pix_fmt rgba
+    png  //每帧一个PNG文件，用于回归测试时的图像比对
+};
+
+/*
+异步帧回读。
+capture(...)录制“图像→主机可见缓冲区”的拷贝并提交，立即返回；缓冲区以环形方式轮换，每个槽位带一个栅栏。
+每帧调用poll(...)以vkGetFenceStatus(...)检查已完成的槽位（不等待），完成的槽位交给写盘线程，写完后槽位才被复用。
+于是渲染线程既不等GPU拷贝，也不等磁盘I/O。所有槽位都被占用时，默认丢弃本帧的回读（计入dropped_count()），
+不拖慢渲染；若要求不丢帧（如离屏回归测试），以drop_when_full = false创建，此时capture(...)会等待最早的槽位。
+支持R8G8B8A8和B8G8R8A8系列格式，写出时统一为RGBA。
+capture(...)和poll(...)须在同一线程调用，并直接访问graphics_base.queue_graphics，该队列不可同时被其他线程使用。
+*/
+class frameReadback {
+public:
+    static constexpr uint32_t max_slot_count = 8;
+private:
+    enum slotState : uint32_t {
+        slot_free,
+        slot_in_flight, //拷贝已提交，等待栅栏
+        slot_writing    //已交给写盘线程
+    };
+    struct slot {
+        bufferMemory buffer_memory;
+        const uint8_t* mapped = nullptr;
+        fence copy_fence;
+        commandBuffer command_buffer;
+        uint64_t frame_index = 0;
+        std::atomic<uint32_t> state = slot_free;
+    };
+
+    VkExtent2D extent = {};
+    bool swizzle_to_rgba = false;
+    bool drop_when_full = true;
+    readbackFileFormat file_format = readbackFileFormat::png;
+    std::filesystem::path directory;
+    std::FILE* raw_file = nullptr;
+
+    commandPool command_pool;
+    std::unique_ptr<slot[]> slots;
+    uint32_t slot_count = 0;
+    //以下计数决定槽位的轮换顺序：第i次回读使用第i % slot_count个槽位，也按这个顺序完成和写出
+    uint64_t captured_count = 0;
+    uint64_t completed_count = 0;
+    uint64_t frames_dropped = 0;
+    std::atomic<uint64_t> written_count = 0;
+
+    mpscQueue<uint32_t, max_slot_count> completed_slots;
+    std::thread thread;
+    std::atomic<bool> stop = false;
+    std::atomic<uint32_t> signal = 0;
+    std::atomic<uint32_t> sleeping = 0;
+
+    void notify() {
+        signal.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst))
+            signal.notify_one();
+    }
+    size_t frame_size() const { return size_t(extent.width) * extent.height * 4; }
+    void write_slot(slot& s, std::vector<uint8_t>& converted) {
+        const uint8_t* pixels = s.mapped;
+        if (swizzle_to_rgba) {
+            //BGRA与RGBA互换用的是同一个通道顺序
+            image_convert::swizzle_rgba(pixels, extent.width * 4, converted.data(), extent.width * 4,
+                extent.width, extent.height, image_convert::swizzle_rgba_to_bgra);
+            pixels = converted.data();
+        }
+        if (file_format == readbackFileFormat::raw) {
+            if (std::fwrite(pixels, 1, frame_size(), raw_file) != frame_size())
+                LogError("[ frameReadback ] ERROR\nFailed to write frame {} to the raw file!\n", s.frame_index);
+        }
+        else {
+            std::string path = (directory / std::format("frame_{:06}.png", s.frame_index)).string();
+            if (!stbi_write_png(path.c_str(), int(extent.width), int(extent.height), 4, pixels, int(extent.width * 4)))
+                LogError("[ frameReadback ] ERROR\nFailed to write {}!\n", path);
+        }
+    }
+    void writer_loop() {
+        std::vector<uint8_t> converted(swizzle_to_rgba ? frame_size() : 0);
+        while (true) {
+            uint32_t observed = signal.load(std::memory_order_seq_cst);
+            bool any = false;
+            for (uint32_t index; completed_slots.pop(index);) {
+                write_slot(slots[index], converted);
+                slots[index].state.store(slot_free, std::memory_order_release);
+                written_count.fetch_add(1, std::memory_order_release);
+                written_count.notify_all();
+                any = true;
+            }
+            if (any)
+                continue;
+            if (stop.load(std::memory_order_acquire))
+                break;
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            signal.wait(observed, std::memory_order_seq_cst);
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+    void record_copy(const slot& s, VkImage image, VkImageLayout layout) const {
+        VkCommandBuffer commandBuffer = s.command_buffer;
+        constexpr VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+        //源图像此前可能由任何命令写入，因此用ALL_COMMANDS和MEMORY_WRITE，回读不在乎这点同步开销
+        VkImageMemoryBarrier imageMemoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout = layout,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = subresourceRange
+        };
+        graphics_base.dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+        VkBufferImageCopy region = {
+            .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .imageExtent = { extent.width, extent.height, 1 }
+        };
+        graphics_base.dispatch.vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, s.buffer_memory.get_buffer(), 1, &region);
+        //把图像换回原来的布局，并让拷贝结果对主机可读
+        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        imageMemoryBarrier.dstAccessMask = 0;
+        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        imageMemoryBarrier.newLayout = layout;
+        VkBufferMemoryBarrier bufferMemoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = s.buffer_memory.get_buffer(),
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+        };
+        graphics_base.dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+            0, nullptr, 1, &bufferMemoryBarrier, 1, &imageMemoryBarrier);
+    }
+public:
+    frameReadback() = default;
+    frameReadback(VkExtent2D extent, VkFormat format, const std::filesystem::path& directory,
+        readbackFileFormat file_format = readbackFileFormat::png, uint32_t slot_count = 3, bool drop_when_full = true) {
+        create(extent, format, directory, file_format, slot_count, drop_when_full);
+    }
+    frameReadback(frameReadback&&) = delete;
+    ~frameReadback() {
+        finish();
+        if (thread.joinable()) {
+            stop.store(true, std::memory_order_release);
+            notify();
+            thread.join();
+        }
+        if (raw_file)
+            std::fclose(raw_file);
+        for (uint32_t i = 0; i < slot_count; i++)
+            if (slots[i].mapped)
+                slots[i].buffer_memory.unmap_memory();
+    }
+    //Getter
+    uint64_t captured_frame_count() const { return captured_count; }
+    uint64_t written_frame_count() const { return written_count.load(std::memory_order_acquire); }
+    uint64_t dropped_count() const { return frames_dropped; }
+    //Non-const Function
+    result_t create(VkExtent2D extent, VkFormat format, const std::filesystem::path& directory,
+        readbackFileFormat file_format = readbackFileFormat::png, uint32_t slot_count = 3, bool drop_when_full = true) {
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM: case VK_FORMAT_R8G8B8A8_SRGB:
+            swizzle_to_rgba = false;
+            break;
+        case VK_FORMAT_B8G8R8A8_UNORM: case VK_FORMAT_B8G8R8A8_SRGB:
+            swizzle_to_rgba = true;
+            break;
+        default:
+            LogError("[ frameReadback ] ERROR\nUnsupported format for readback: {}\n", int32_t(format));
+            return VK_ERROR_FORMAT_NOT_SUPPORTED;
+        }
+        this->extent = extent;
+        this->file_format = file_format;
+        this->drop_when_full = drop_when_full;
+        this->directory = directory;
+        slot_count = std::clamp(slot_count, 1u, max_slot_count);
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (file_format == readbackFileFormat::raw) {
+            std::string path = (directory / "frames.rgba").string();
+            if (!(raw_file = std::fopen(path.c_str(), "wb"))) {
+                LogError("[ frameReadback ] ERROR\nFailed to open {}!\n", path);
+                return VK_RESULT_MAX_ENUM;
+            }
+            LogInfo("[ frameReadback ]\nWriting {}x{} RGBA frames to {}\n", extent.width, extent.height, path);
+        }
+
+        if (VkResult result = command_pool.create(graphics_base.queue_family_index_graphics, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT))
+            return result;
+        /*
+        回读的缓冲区由主机读取，优先选用HOST_CACHED的内存类型，否则从uncached内存读取会非常慢。
+        须是该缓冲区可用（memoryTypeBits中）的类型，没有时退回规范保证存在的HOST_VISIBLE|HOST_COHERENT；
+        非host coherent内存在poll()中invalidate。以相同参数创建的缓冲区的memoryTypeBits相同，先创建一个缓冲区查询即可。
+        */
+        VkBufferCreateInfo bufferCreateInfo = {
+            .size = frame_size(),
+            .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT
+        };
+        VkMemoryPropertyFlags memory_properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        {
+            buffer probe;
+            if (VkResult result = probe.create(bufferCreateInfo))
+                return result;
+            uint32_t memory_type_bits = probe.memory_requirements().memoryTypeBits;
+            constexpr VkMemoryPropertyFlags cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+            const auto& memory_types = graphics_base.physical_device_memory_properties;
+            for (uint32_t i = 0; i < memory_types.memoryTypeCount; i++)
+                if (memory_type_bits & 1 << i &&
+                    (memory_types.memoryTypes[i].propertyFlags & cached) == cached) {
+                    memory_properties = cached;
+                    break;
+                }
+        }
+        slots = std::make_unique<slot[]>(slot_count);
+        this->slot_count = slot_count;
+        for (uint32_t i = 0; i < slot_count; i++) {
+            slot& s = slots[i];
+            void* data;
+            VkResult result = s.buffer_memory.create(bufferCreateInfo, memory_properties);
+            result || (result = s.buffer_memory.map_memory(data));
+            result || (result = command_pool.allocate_buffers({ &s.command_buffer, 1 }));
+            if (result) {
+                LogError("[ frameReadback ] ERROR\nFailed to create readback slot {}!\nError code: {}\n", i, int32_t(result));
+                return result;
+            }
+            s.mapped = static_cast<const uint8_t*>(data);
+        }
+        thread = std::thread(&frameReadback::writer_loop, this);
+        return VK_SUCCESS;
+    }
+    /*
+    回读image（须为创建时的尺寸和格式，且处于layout布局），命令执行完后image回到layout布局。
+    wait_semaphore和signal_semaphore用于与交换链配合：等待渲染完成，并在拷贝完成后通知呈现。
+    返回false表示本帧被丢弃，此时信号量未被使用，调用者应照常用原来的信号量呈现。
+    */
+    bool capture(VkImage image, VkImageLayout layout, uint64_t frame_index,
+        VkSemaphore wait_semaphore = VK_NULL_HANDLE, VkSemaphore signal_semaphore = VK_NULL_HANDLE) {
+        slot& s = slots[captured_count % slot_count];
+        while (s.state.load(std::memory_order_acquire) != slot_free) {
+            if (drop_when_full) {
+                frames_dropped++;
+                return false;
+            }
+            if (s.state.load(std::memory_order_acquire) == slot_in_flight)
+                s.copy_fence.wait();
+            poll();
+            //先读计数再检查状态：写盘线程先把槽位标为空闲再增加计数，这样不会错过唤醒
+            uint64_t written = written_count.load(std::memory_order_acquire);
+            if (s.state.load(std::memory_order_acquire) == slot_writing)
+                written_count.wait(written, std::memory_order_acquire);
+        }
+        s.frame_index = frame_index;
+        s.command_buffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        record_copy(s, image, layout);
+        s.command_buffer.end();
+        VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = uint32_t(bool(wait_semaphore)),
+            .pWaitSemaphores = &wait_semaphore,
+            .pWaitDstStageMask = &waitDstStageMask,
+            .commandBufferCount = 1,
+            .pCommandBuffers = s.command_buffer.Address(),
+            .signalSemaphoreCount = uint32_t(bool(signal_semaphore)),
+            .pSignalSemaphores = &signal_semaphore
+        };
+        s.copy_fence.reset();
+        if (VkResult result = graphics_base.dispatch.vkQueueSubmit(graphics_base.queue_graphics, 1, &submitInfo, s.copy_fence)) {
+            LogError("[ frameReadback ] ERROR\nFailed to submit the readback commands!\nError code: {}\n", int32_t(result));
+            return false;
+        }
+        s.state.store(slot_in_flight, std::memory_order_relaxed);
+        captured_count++;
+        return true;
+    }
+    //不阻塞地把已完成拷贝的槽位按顺序交给写盘线程，每帧调用一次
+    void poll() {
+        bool any = false;
+        while (completed_count < captured_count) {
+            uint32_t index = completed_count % slot_count;
+            slot& s = slots[index];
+            if (s.copy_fence.status() != VK_SUCCESS)
+                break;
+            s.buffer_memory.invalidate();
+            s.state.store(slot_writing, std::memory_order_relaxed);
+            completed_slots.push(index);//槽位数不超过队列容量，不会失败
+            completed_count++;
+            any = true;
+        }
+        if (any)
+            notify();
+    }
+    //阻塞至所有已提交的回读都写到磁盘，用于结束录制时
+    void finish() {
+        for (uint64_t i = completed_count; i < captured_count; i++)
+            slots[i % slot_count].copy_fence.wait();
+        poll();
+        for (uint64_t written; (written = written_count.load(std::memory_order_acquire)) < completed_count;)
+            written_count.wait(written, std::memory_order_acquire);
+        if (raw_file)
+            std::fflush(raw_file);
+    }
+};
+
+}
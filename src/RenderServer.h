@@ -0,0 +1,432 @@
+#pragma once
+//依赖POSIX的Unix域套接字，Windows上本文件不产生任何代码，包含前应检查_WIN32
+#ifndef _WIN32
+#include "MpscQueue.h"
+#include "Logger.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vulkan {
+
+/*
+常驻的渲染服务，免去每个任务都要重新创建实例、设备、交换链和管线的开销。
+协议基于Unix域套接字上的文本行：
+    请求：<命令> [参数]\n
+    回应：ok <排队微秒数> <执行微秒数> <结果>\n 或 error <排队微秒数> <执行微秒数> <信息>\n
+客户端可以一次发送多行，服务按序回应。内置命令：
+    stats     返回已完成的任务数、平均排队和执行时间、最大延迟及吞吐量
+    shutdown  处理完此前的任务后停止服务
+    quit      关闭本连接（无回应）
+其余命令由register_handler(...)注册。
+每个连接由一个线程读写，任务经MPSC队列交给调用run()的线程依次执行，
+因此处理函数总在同一线程上运行，可以直接使用graphics_base及其他只在该线程上访问的对象。
+*/
+class renderServer {
+public:
+    static constexpr uint32_t queue_capacity = 256;
+    static constexpr size_t max_command_length = 256;
+    static constexpr uint32_t max_pipelined_count = 64; //一个连接上同时在队列中的任务数
+    //arguments为命令名之后的部分，返回false表示失败，此时result为错误信息
+    using handler_t = std::function<bool(std::string_view arguments, std::string& result)>;
+    struct statistics {
+        uint64_t completed_count = 0;
+        uint64_t failed_count = 0;
+        double total_queue_ms = 0;
+        double total_execution_ms = 0;
+        double max_latency_ms = 0;
+        double busy_ms = 0; //执行任务的总时间
+    };
+private:
+    using clock = std::chrono::steady_clock;
+    struct pendingJob {
+        std::string result;
+        bool succeeded = false;
+        double queue_ms = 0;
+        double execution_ms = 0;
+        clock::time_point enqueue_time;
+        std::atomic<bool> done = false;
+    };
+    struct job {
+        char command[max_command_length];
+        pendingJob* pending;
+    };
+
+    std::string socket_path;
+    int listen_fd = -1;
+    std::unordered_map<std::string, handler_t> handlers;
+    mpscQueue<job, queue_capacity> jobs;
+    std::atomic<bool> stop = false;
+    std::atomic<uint32_t> signal = 0;
+    std::atomic<uint32_t> sleeping = 0;
+    statistics stats;
+    clock::time_point start_time;
+
+    //fd在连接线程关闭它时置为-1（持有connection_mutex），因此close_server()不会误关已被复用的描述符
+    struct connection {
+        std::thread thread;
+        int fd = -1;
+        bool done = false; //连接线程即将退出，可以join
+    };
+    std::thread listener;
+    std::mutex connection_mutex;
+    std::list<connection> connections; //list使元素地址不变，连接线程持有自己那一项的引用
+    std::atomic<uint32_t> active_connection_count = 0;
+
+    void notify() {
+        signal.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst))
+            signal.notify_one();
+    }
+    static double elapsed_ms(clock::time_point begin, clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - begin).count();
+    }
+    static void complete(pendingJob& pending, bool succeeded, std::string_view result) {
+        pending.result = result;
+        pending.succeeded = succeeded;
+        pending.done.store(true, std::memory_order_release);
+        pending.done.notify_one();
+    }
+    static bool send_all(int fd, std::string_view data) {
+        while (!data.empty()) {
+            ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (sent <= 0)
+                return false;
+            data.remove_prefix(sent);
+        }
+        return true;
+    }
+    void enqueue(std::string_view command, pendingJob& pending) {
+        pending.done.store(false, std::memory_order_relaxed);
+        pending.enqueue_time = clock::now();
+        if (command.size() >= max_command_length) {
+            complete(pending, false, "command too long");
+            return;
+        }
+        if (stop.load(std::memory_order_acquire)) {
+            complete(pending, false, "server is shutting down");
+            return;
+        }
+        auto fill = [&](job& j) {
+            std::memcpy(j.command, command.data(), command.size());
+            j.command[command.size()] = 0;
+            j.pending = &pending;
+        };
+        while (!jobs.emplace(fill)) {
+            //队列满了，唤醒执行线程并让出时间片
+            notify();
+            std::this_thread::yield();
+        }
+        notify();
+    }
+    void execute(job& j) {
+        pendingJob& pending = *j.pending;
+        clock::time_point begin = clock::now();
+        pending.queue_ms = elapsed_ms(pending.enqueue_time, begin);
+        std::string_view command = j.command;
+        size_t space = command.find(' ');
+        std::string_view name = command.substr(0, space);
+        std::string_view arguments = space == command.npos ? std::string_view() : command.substr(space + 1);
+        std::string result;
+        bool succeeded = true;
+        if (name == "stats")
+            result = format_statistics();
+        else if (name == "shutdown") {
+            stop.store(true, std::memory_order_release);
+            result = "shutting down";
+        }
+        else if (auto handler = handlers.find(std::string(name)); handler != handlers.end())
+            succeeded = handler->second(arguments, result);
+        else {
+            succeeded = false;
+            result = std::format("unknown command: {}", name);
+        }
+        clock::time_point end = clock::now();
+        pending.execution_ms = elapsed_ms(begin, end);
+        stats.completed_count++;
+        stats.failed_count += !succeeded;
+        stats.total_queue_ms += pending.queue_ms;
+        stats.total_execution_ms += pending.execution_ms;
+        stats.busy_ms += pending.execution_ms;
+        stats.max_latency_ms = std::max(stats.max_latency_ms, elapsed_ms(pending.enqueue_time, end));
+        complete(pending, succeeded, result);
+    }
+    //服务停止后，把仍在队列中的任务以失败回应，好让连接线程退出
+    void reject_pending_jobs() {
+        while (job* j = jobs.front()) {
+            complete(*j->pending, false, "server is shutting down");
+            jobs.pop_front();
+        }
+    }
+    void connection_loop(connection& c) {
+        static constexpr size_t buffer_size = max_command_length * max_pipelined_count;
+        int fd = c.fd;
+        auto buffer = std::make_unique<char[]>(buffer_size);
+        auto batch = std::make_unique<pendingJob[]>(max_pipelined_count);
+        size_t size = 0;
+        bool open = true;
+        bool discarding = false; //正在跳过一行超长命令的剩余部分
+        std::string response;
+        while (open) {
+            //缓冲区里没有完整的行时才继续接收；此时之前的行都已回应，直接回应错误不会打乱顺序
+            if (!std::memchr(buffer.get(), '\n', size)) {
+                //缓冲区已满仍没有换行符：丢弃这一行已收到的部分，并跳过输入直至该行结束
+                if (size == buffer_size) {
+                    discarding = true;
+                    size = 0;
+                }
+                ssize_t received = recv(fd, buffer.get() + size, buffer_size - size, 0);
+                if (received <= 0)
+                    break;
+                size += received;
+                if (discarding) {
+                    char* newline = static_cast<char*>(std::memchr(buffer.get(), '\n', size));
+                    if (!newline) {
+                        size = 0;
+                        continue;
+                    }
+                    size_t consumed = newline - buffer.get() + 1;
+                    std::memmove(buffer.get(), buffer.get() + consumed, size - consumed);
+                    size -= consumed;
+                    discarding = false;
+                    //整行只回应一次错误
+                    if (!send_all(fd, "error 0 0 command too long\n"))
+                        break;
+                }
+                continue;
+            }
+            //把已收到的完整行全部入队，再按序等待并回应，这样同一连接上的多个任务可以连续执行
+            size_t consumed = 0;
+            uint32_t batch_size = 0;
+            for (char* newline; batch_size < max_pipelined_count &&
+                (newline = static_cast<char*>(std::memchr(buffer.get() + consumed, '\n', size - consumed)));) {
+                std::string_view line(buffer.get() + consumed, newline);
+                consumed = newline - buffer.get() + 1;
+                if (line.ends_with('\r'))
+                    line.remove_suffix(1);
+                if (line.empty())
+                    continue;
+                if (line == "quit") {
+                    open = false;
+                    break;
+                }
+                enqueue(line, batch[batch_size++]);
+            }
+            response.clear();
+            for (uint32_t i = 0; i < batch_size; i++) {
+                pendingJob& pending = batch[i];
+                pending.done.wait(false, std::memory_order_acquire);
+                std::format_to(std::back_inserter(response), "{} {} {} {}\n", pending.succeeded ? "ok" : "error",
+                    int64_t(pending.queue_ms * 1000), int64_t(pending.execution_ms * 1000), pending.result);
+            }
+            if (!send_all(fd, response))
+                break;
+            std::memmove(buffer.get(), buffer.get() + consumed, size - consumed);
+            size -= consumed;
+        }
+        {
+            std::lock_guard lock(connection_mutex);
+            close(fd);
+            c.fd = -1;
+            c.done = true;
+        }
+        active_connection_count.fetch_sub(1, std::memory_order_release);
+    }
+    //join已结束的连接线程并移除其记录，须持有connection_mutex
+    void reap_connections() {
+        for (auto i = connections.begin(); i != connections.end();)
+            if (i->done) {
+                i->thread.join();
+                i = connections.erase(i);
+            }
+            else
+                ++i;
+    }
+    void listener_loop() {
+        while (!stop.load(std::memory_order_acquire)) {
+            int fd = accept(listen_fd, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;
+            }
+            std::lock_guard lock(connection_mutex);
+            //常驻的服务会服务大量客户端，每次接受连接时回收已结束的线程，线程数只随同时在线的连接数增长
+            reap_connections();
+            active_connection_count.fetch_add(1, std::memory_order_relaxed);
+            connection& c = connections.emplace_back();
+            c.fd = fd;
+            c.thread = std::thread(&renderServer::connection_loop, this, std::ref(c));
+        }
+    }
+public:
+    renderServer() = default;
+    renderServer(renderServer&&) = delete;
+    ~renderServer() {
+        close_server();
+    }
+    //Getter
+    const statistics& get_statistics() const { return stats; }
+    std::string format_statistics() const {
+        double seconds = elapsed_ms(start_time, clock::now()) / 1000;
+        uint64_t count = std::max<uint64_t>(stats.completed_count, 1);
+        return std::format("completed {} failed {} avg_queue_ms {:.3f} avg_execution_ms {:.3f} max_latency_ms {:.3f} jobs_per_second {:.2f} utilization {:.1f}%",
+            stats.completed_count, stats.failed_count, stats.total_queue_ms / count, stats.total_execution_ms / count,
+            stats.max_latency_ms, stats.completed_count / std::max(seconds, 1e-9), stats.busy_ms / std::max(seconds * 10, 1e-9));
+    }
+    //Non-const Function
+    //须在run()之前注册
+    void register_handler(std::string_view name, handler_t handler) {
+        handlers[std::string(name)] = std::move(handler);
+    }
+    //创建套接字并开始接受连接，若路径上已有旧的套接字文件则先删除
+    bool listen(std::string_view path) {
+        sockaddr_un address = { .sun_family = AF_UNIX };
+        if (path.size() >= sizeof address.sun_path) {
+            LogError("[ renderServer ] ERROR\nSocket path is too long: {}\n", path);
+            return false;
+        }
+        std::memcpy(address.sun_path, path.data(), path.size());
+        socket_path = path;
+        unlink(socket_path.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 ||
+            bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof address) ||
+            ::listen(listen_fd, 16)) {
+            LogError("[ renderServer ] ERROR\nFailed to listen on {}!\nError: {}\n", path, std::strerror(errno));
+            if (listen_fd >= 0) {
+                close(listen_fd);
+                listen_fd = -1;
+            }
+            return false;
+        }
+        stop.store(false, std::memory_order_relaxed);
+        start_time = clock::now();
+        listener = std::thread(&renderServer::listener_loop, this);
+        LogInfo("[ renderServer ]\nListening on {}\n", path);
+        return true;
+    }
+    //在当前线程上依次执行任务，直至收到shutdown命令或stop_async()被调用
+    void run() {
+        while (true) {
+            uint32_t observed = signal.load(std::memory_order_seq_cst);
+            bool any = false;
+            while (job* j = jobs.front()) {
+                execute(*j);
+                jobs.pop_front();
+                any = true;
+                if (stop.load(std::memory_order_acquire))
+                    break;
+            }
+            if (stop.load(std::memory_order_acquire))
+                break;
+            if (any)
+                continue;
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            signal.wait(observed, std::memory_order_seq_cst);
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        }
+        close_server();
+    }
+    //可在任意线程（如信号处理之外的监控线程）调用，run()会在当前任务完成后返回
+    void stop_async() {
+        stop.store(true, std::memory_order_release);
+        notify();
+    }
+    //关闭监听和所有连接，等待连接线程退出
+    void close_server() {
+        stop.store(true, std::memory_order_release);
+        if (listen_fd >= 0) {
+            //唤醒阻塞在accept(...)上的监听线程
+            shutdown(listen_fd, SHUT_RDWR);
+            if (listener.joinable())
+                listener.join();
+            close(listen_fd);
+            listen_fd = -1;
+            unlink(socket_path.c_str());
+        }
+        {
+            std::lock_guard lock(connection_mutex);
+            //只关闭读端，让连接线程在回应完手上的任务（如shutdown命令本身）后退出；已关闭的连接fd为-1
+            for (auto& i : connections)
+                if (i.fd >= 0)
+                    shutdown(i.fd, SHUT_RD);
+        }
+        //连接线程可能正等待已入队的任务，需一边拒绝任务一边等它们退出；连接线程退出时要取得connection_mutex，因此这里不能持有它
+        while (active_connection_count.load(std::memory_order_acquire)) {
+            reject_pending_jobs();
+            std::this_thread::yield();
+        }
+        reject_pending_jobs();
+        std::lock_guard lock(connection_mutex);
+        reap_connections();
+    }
+};
+
+//渲染服务的客户端，可替代任务调度器进行测试
+class renderClient {
+    int fd = -1;
+    std::string buffer;
+public:
+    renderClient() = default;
+    renderClient(renderClient&&) = delete;
+    ~renderClient() {
+        if (fd >= 0)
+            close(fd);
+    }
+    //Non-const Function
+    bool connect(std::string_view path) {
+        sockaddr_un address = { .sun_family = AF_UNIX };
+        if (path.size() >= sizeof address.sun_path) {
+            LogError("[ renderClient ] ERROR\nSocket path is too long: {}\n", path);
+            return false;
+        }
+        std::memcpy(address.sun_path, path.data(), path.size());
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address)) {
+            LogError("[ renderClient ] ERROR\nFailed to connect to {}!\nError: {}\n", path, std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    //发送一条命令，不等待回应；可连续发送多条，之后按序接收
+    bool send_command(std::string_view command) {
+        std::string line = std::format("{}\n", command);
+        std::string_view data = line;
+        while (!data.empty()) {
+            ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+            if (sent <= 0)
+                return false;
+            data.remove_prefix(sent);
+        }
+        return true;
+    }
+    //接收一行回应（不含换行符），连接断开时返回false
+    bool receive_response(std::string& response) {
+        size_t newline;
+        while ((newline = buffer.find('\n')) == buffer.npos) {
+            char chunk[4096];
+            ssize_t received = recv(fd, chunk, sizeof chunk, 0);
+            if (received <= 0)
+                return false;
+            buffer.append(chunk, received);
+        }
+        response.assign(buffer, 0, newline);
+        buffer.erase(0, newline + 1);
+        return true;
+    }
+};
+
+}
+#endif
@@ -0,0 +1,339 @@
+#pragma once
+#include "VKBase.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <span>
+
+namespace vulkan {
+
+//residencyManager的参数，定义在类外以便用作默认参数
+struct residencySettings {
+    uint32_t query_interval = 30; //查询驱动预算的间隔帧数
+    float headroom = 0.05f; //预算中不使用的比例，避免在预算边缘反复驱逐和载入
+    float fallback_budget_scale = 0.8f; //不支持VK_EXT_memory_budget时，预算为堆大小的这一比例
+    uint32_t min_idle_frames = 2; //距上次使用不足该帧数的纹理视为正在使用
+    uint32_t whole_eviction_age = 300; //闲置达到该帧数的纹理可被整个驱逐
+    VkDeviceSize stream_bytes_per_frame = 64 << 20; //每帧最多载入的字节数
+};
+
+/*
+纹理驻留管理器，按显存堆的预算决定各纹理有哪些mip级别留在显存中。
+1.预算：启用了VK_EXT_memory_budget时（见graphicsBase::add_device_extension_if_supported(...)），
+  每隔query_interval帧用vkGetPhysicalDeviceMemoryProperties2(...)查询驱动给出的堆预算和用量，两次查询之间以本类记录的增减修正用量；
+  否则以physical_device_memory_properties中堆大小的fallback_budget_scale倍为预算，用量只计本类管理的纹理。
+2.使用记录：渲染时对用到的纹理调用use(...)，记下使用的帧和所需的最高mip级别，可在多个线程上同时调用。
+3.每帧调用一次update(...)：
+  先把超出预算（留出headroom的余量）的部分按最近最少使用的顺序驱逐，
+  闲置不足whole_eviction_age帧的纹理从最高mip起逐级丢弃，但保留最低一级，闲置更久的整个驱逐；本帧及之前min_idle_frames帧内用过的纹理只丢弃超出其所需级别的mip；
+  再按最近使用的顺序载回被请求的mip，每帧载入的字节数不超过stream_bytes_per_frame，空间不足时先驱逐闲置纹理，仍不足则只载入较粗的mip。
+本类不持有图像，实际的驱逐和载入由回调完成：callback(texture, old_base_mip, new_base_mip)，
+base_mip为驻留的最高（最精细）mip级别，等于mip数时表示整个纹理不在显存中；新值大于旧值即驱逐，小于即载入，返回false表示未能完成。
+除use(...)外，所有函数须在同一线程上调用，且调用期间不得有其他线程调用use(...)。
+*/
+class residencyManager {
+public:
+    using textureHandle = uint32_t;
+    using residencyCallback = std::function<bool(textureHandle texture, uint32_t old_base_mip, uint32_t new_base_mip)>;
+    static constexpr textureHandle invalid_texture = UINT32_MAX;
+    struct heapStatistics {
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0; //估计的当前用量，支持VK_EXT_memory_budget时包含其他分配
+        VkDeviceSize resident_bytes = 0; //本类管理的纹理的驻留大小
+    };
+    struct statistics {
+        VkDeviceSize evicted_bytes = 0;
+        VkDeviceSize streamed_bytes = 0;
+        uint32_t evicted_mip_count = 0;
+        uint32_t evicted_texture_count = 0; //整个驱逐的次数
+        uint32_t streamed_mip_count = 0;
+        uint32_t deferred_request_count = 0; //因预算或每帧上限未能（完全）满足的请求数
+    };
+private:
+    struct texture {
+        uint32_t heap_index = 0;
+        uint32_t mip_count = 0; //为0表示该槽位空闲
+        uint32_t resident_base_mip = 0;
+        uint32_t wanted_base_mip = 0; //最近一次处理的请求
+        //resident_sizes[i]为mip i及更粗的各级的大小之和，resident_sizes[mip_count]为0
+        std::vector<VkDeviceSize> resident_sizes;
+        std::atomic<uint64_t> last_used_frame = 0;
+        std::atomic<uint32_t> requested_base_mip = UINT32_MAX;
+    };
+    struct heap {
+        VkDeviceSize budget = 0;
+        VkDeviceSize driver_usage = 0; //上次查询时驱动报告的用量
+        VkDeviceSize resident_at_query = 0; //上次查询时的resident_bytes
+        VkDeviceSize resident_bytes = 0;
+        //无符号数的回绕不影响结果
+        VkDeviceSize usage() const { return driver_usage + resident_bytes - resident_at_query; }
+    };
+    struct candidate {
+        textureHandle texture;
+        uint32_t floor_base_mip; //最多驱逐到这一级
+        uint64_t last_used_frame;
+    };
+    residencySettings config;
+    residencyCallback callback;
+    PFN_vkGetPhysicalDeviceMemoryProperties2 vkGetPhysicalDeviceMemoryProperties2 = nullptr;
+    heap heaps[VK_MAX_MEMORY_HEAPS];
+    uint32_t heap_count = 0;
+    //deque使已登记纹理的地址在登记新纹理时不变
+    std::deque<texture> textures;
+    std::vector<textureHandle> free_handles;
+    std::atomic<uint64_t> current_frame = 0;
+    uint64_t last_query_frame = 0;
+    bool queried = false;
+    statistics stats;
+    //update(...)中复用
+    std::vector<candidate> candidates;
+    std::vector<textureHandle> requests;
+
+    void query_budget() {
+        const VkPhysicalDeviceMemoryProperties& memory_properties = graphics_base.physical_device_memory_properties;
+        heap_count = memory_properties.memoryHeapCount;
+        if (vkGetPhysicalDeviceMemoryProperties2) {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT
+            };
+            VkPhysicalDeviceMemoryProperties2 memory_properties2 = {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+                .pNext = &budget_properties
+            };
+            vkGetPhysicalDeviceMemoryProperties2(graphics_base.physical_device, &memory_properties2);
+            for (uint32_t i = 0; i < heap_count; i++) {
+                heaps[i].budget = budget_properties.heapBudget[i];
+                heaps[i].driver_usage = budget_properties.heapUsage[i];
+                heaps[i].resident_at_query = heaps[i].resident_bytes;
+            }
+        }
+        else
+            //驱动用量未知，只计本类的纹理
+            for (uint32_t i = 0; i < heap_count; i++) {
+                heaps[i].budget = VkDeviceSize(memory_properties.memoryHeaps[i].size * config.fallback_budget_scale);
+                heaps[i].driver_usage = 0;
+                heaps[i].resident_at_query = 0;
+            }
+    }
+    VkDeviceSize target(uint32_t heap_index) const {
+        return heaps[heap_index].budget - VkDeviceSize(heaps[heap_index].budget * config.headroom);
+    }
+    //调用回调把纹理的驻留级别改为new_base_mip，并更新用量和统计
+    bool set_base_mip(textureHandle handle, uint32_t new_base_mip) {
+        texture& t = textures[handle];
+        uint32_t old_base_mip = t.resident_base_mip;
+        if (new_base_mip == old_base_mip)
+            return true;
+        if (!callback(handle, old_base_mip, new_base_mip))
+            return false;
+        heap& h = heaps[t.heap_index];
+        VkDeviceSize old_size = t.resident_sizes[old_base_mip];
+        VkDeviceSize new_size = t.resident_sizes[new_base_mip];
+        h.resident_bytes = h.resident_bytes - old_size + new_size;
+        if (new_base_mip > old_base_mip) {
+            stats.evicted_bytes += old_size - new_size;
+            stats.evicted_mip_count += new_base_mip - old_base_mip;
+            stats.evicted_texture_count += new_base_mip == t.mip_count;
+        }
+        else {
+            stats.streamed_bytes += new_size - old_size;
+            stats.streamed_mip_count += old_base_mip - new_base_mip;
+        }
+        t.resident_base_mip = new_base_mip;
+        return true;
+    }
+    //按candidates的顺序（最近最少使用的在前）驱逐heap_index堆中的纹理，直至至少释放bytes字节，返回实际释放的字节数
+    VkDeviceSize evict(uint32_t heap_index, VkDeviceSize bytes, uint64_t newer_than = UINT64_MAX) {
+        VkDeviceSize freed = 0;
+        for (candidate& c : candidates) {
+            if (freed >= bytes || c.last_used_frame >= newer_than)
+                break;
+            texture& t = textures[c.texture];
+            if (t.heap_index != heap_index)
+                continue;
+            //整个驱逐的一次到位，否则逐级丢弃最高的mip
+            uint32_t base_mip = t.resident_base_mip;
+            while (base_mip < c.floor_base_mip && freed < bytes) {
+                uint32_t next = c.floor_base_mip == t.mip_count ? t.mip_count : base_mip + 1;
+                VkDeviceSize released = t.resident_sizes[base_mip] - t.resident_sizes[next];
+                if (!set_base_mip(c.texture, next))
+                    break;
+                freed += released;
+                base_mip = next;
+            }
+        }
+        return freed;
+    }
+    void collect_candidates(uint64_t frame_index) {
+        candidates.clear();
+        for (textureHandle i = 0; i < textures.size(); i++) {
+            texture& t = textures[i];
+            if (!t.mip_count)
+                continue;
+            uint64_t last_used_frame = t.last_used_frame.load(std::memory_order_relaxed);
+            uint64_t idle_frame_count = frame_index - std::min(last_used_frame, frame_index);
+            uint32_t floor_base_mip =
+                idle_frame_count >= config.whole_eviction_age ? t.mip_count :
+                idle_frame_count >= config.min_idle_frames ? t.mip_count - 1 :
+                std::max(t.wanted_base_mip, t.resident_base_mip);
+            if (t.resident_base_mip < floor_base_mip)
+                candidates.push_back({ i, floor_base_mip, last_used_frame });
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const candidate& a, const candidate& b) {
+            return a.last_used_frame < b.last_used_frame;
+        });
+    }
+public:
+    residencyManager() = default;
+    residencyManager(residencyCallback callback, const residencySettings& config = {}) {
+        create(std::move(callback), config);
+    }
+    residencyManager(residencyCallback callback, PFN_vkGetPhysicalDeviceMemoryProperties2 query_function, const residencySettings& config = {}) {
+        create(std::move(callback), query_function, config);
+    }
+    residencyManager(residencyManager&&) = delete;
+    //Getter
+    bool budget_query_supported() const { return vkGetPhysicalDeviceMemoryProperties2; }
+    const statistics& get_statistics() const { return stats; }
+    uint32_t texture_resident_base_mip(textureHandle handle) const { return textures[handle].resident_base_mip; }
+    //Const Function
+    heapStatistics heap_statistics(uint32_t heap_index) const {
+        const heap& h = heaps[heap_index];
+        return { h.budget, h.usage(), h.resident_bytes };
+    }
+    //返回带VK_MEMORY_HEAP_DEVICE_LOCAL_BIT的最大的堆，纹理一般放在这里
+    uint32_t device_local_heap_index() const {
+        const VkPhysicalDeviceMemoryProperties& memory_properties = graphics_base.physical_device_memory_properties;
+        uint32_t index = 0;
+        for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+            if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT &&
+                (!(memory_properties.memoryHeaps[index].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ||
+                    memory_properties.memoryHeaps[i].size > memory_properties.memoryHeaps[index].size))
+                index = i;
+        return index;
+    }
+    //Non-const Function
+    //须在create_device()之后调用，启用了VK_EXT_memory_budget时由实例加载vkGetPhysicalDeviceMemoryProperties2(...)
+    void create(residencyCallback callback, const residencySettings& config = {}) {
+        PFN_vkGetPhysicalDeviceMemoryProperties2 query_function = nullptr;
+        if (graphics_base.is_device_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+            if (const char* name = graphics_base.physical_device_memory_properties2_name())
+                query_function = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2>(vkGetInstanceProcAddr(graphics_base.instance, name));
+        create(std::move(callback), query_function, config);
+    }
+    //以query_function查询驱动给出的预算和用量，为nullptr时以堆大小的fallback_budget_scale倍为预算
+    void create(residencyCallback callback, PFN_vkGetPhysicalDeviceMemoryProperties2 query_function, const residencySettings& config = {}) {
+        this->callback = std::move(callback);
+        this->config = config;
+        vkGetPhysicalDeviceMemoryProperties2 = query_function;
+        if (!vkGetPhysicalDeviceMemoryProperties2)
+            LogInfo("[ residencyManager ]\nVK_EXT_memory_budget is unavailable, budgets fall back to {}% of heap sizes.\n",
+                int(config.fallback_budget_scale * 100));
+        queried = false;
+        query_budget();
+    }
+    //mip_sizes[i]为mip i所占的显存大小，纹理登记时视为已全部驻留（即已经创建好），返回的句柄在unregister_texture(...)后可能被复用
+    textureHandle register_texture(uint32_t heap_index, std::span<const VkDeviceSize> mip_sizes) {
+        if (mip_sizes.empty() || heap_index >= heap_count) {
+            LogError("[ residencyManager ] ERROR\nInvalid texture registration! Heap index: {}, mip count: {}\n", heap_index, mip_sizes.size());
+            return invalid_texture;
+        }
+        textureHandle handle;
+        if (free_handles.size()) {
+            handle = free_handles.back();
+            free_handles.pop_back();
+        }
+        else {
+            handle = textureHandle(textures.size());
+            textures.emplace_back();
+        }
+        texture& t = textures[handle];
+        t.heap_index = heap_index;
+        t.mip_count = uint32_t(mip_sizes.size());
+        t.resident_base_mip = t.wanted_base_mip = 0;
+        t.resident_sizes.resize(mip_sizes.size() + 1);
+        t.resident_sizes.back() = 0;
+        for (size_t i = mip_sizes.size(); i; i--)
+            t.resident_sizes[i - 1] = t.resident_sizes[i] + mip_sizes[i - 1];
+        t.last_used_frame.store(current_frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        t.requested_base_mip.store(UINT32_MAX, std::memory_order_relaxed);
+        heaps[heap_index].resident_bytes += t.resident_sizes[0];
+        return handle;
+    }
+    //纹理的内存由调用者释放，此处不调用回调
+    void unregister_texture(textureHandle handle) {
+        texture& t = textures[handle];
+        if (!t.mip_count)
+            return;
+        heaps[t.heap_index].resident_bytes -= t.resident_sizes[t.resident_base_mip];
+        t.mip_count = 0;
+        t.resident_sizes.clear();
+        free_handles.push_back(handle);
+    }
+    //记录本帧用到了该纹理，且需要base_mip及更粗的mip，可在多个线程上同时调用
+    void use(textureHandle handle, uint32_t base_mip = 0) {
+        texture& t = textures[handle];
+        t.last_used_frame.store(current_frame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        uint32_t requested = t.requested_base_mip.load(std::memory_order_relaxed);
+        while (base_mip < requested &&
+            !t.requested_base_mip.compare_exchange_weak(requested, base_mip, std::memory_order_relaxed));
+    }
+    //每帧调用一次，frame_index应单调递增，处理的是此前use(...)的记录，之后的use(...)记到frame_index对应的帧上
+    void update(uint64_t frame_index) {
+        if (!queried || frame_index - last_query_frame >= config.query_interval) {
+            query_budget();
+            last_query_frame = frame_index;
+            queried = true;
+        }
+        //收集本帧的请求，被请求的纹理只会被驱逐到其所需的级别为止
+        requests.clear();
+        for (textureHandle i = 0; i < textures.size(); i++) {
+            texture& t = textures[i];
+            if (!t.mip_count)
+                continue;
+            uint32_t requested = t.requested_base_mip.exchange(UINT32_MAX, std::memory_order_relaxed);
+            if (requested == UINT32_MAX)
+                continue;
+            t.wanted_base_mip = std::min(requested, t.mip_count - 1);
+            if (t.wanted_base_mip < t.resident_base_mip)
+                requests.push_back(i);
+        }
+        collect_candidates(frame_index);
+        //超出预算的部分先驱逐
+        for (uint32_t i = 0; i < heap_count; i++)
+            if (VkDeviceSize usage = heaps[i].usage(), target = this->target(i); usage > target)
+                evict(i, usage - target);
+        //最近使用的请求优先
+        std::sort(requests.begin(), requests.end(), [this](textureHandle a, textureHandle b) {
+            return textures[a].last_used_frame.load(std::memory_order_relaxed) > textures[b].last_used_frame.load(std::memory_order_relaxed);
+        });
+        VkDeviceSize streamed = 0;
+        for (textureHandle handle : requests) {
+            texture& t = textures[handle];
+            heap& h = heaps[t.heap_index];
+            uint64_t last_used_frame = t.last_used_frame.load(std::memory_order_relaxed);
+            uint32_t base_mip = t.wanted_base_mip;
+            for (; base_mip < t.resident_base_mip; base_mip++) {
+                VkDeviceSize size = t.resident_sizes[base_mip] - t.resident_sizes[t.resident_base_mip];
+                if (streamed + size > config.stream_bytes_per_frame)
+                    continue;
+                VkDeviceSize usage = h.usage(), target = this->target(t.heap_index);
+                if (usage + size <= target)
+                    break;
+                //只驱逐比该纹理更久未用的纹理，仍不够时尝试更粗的mip
+                if (evict(t.heap_index, usage + size - target, last_used_frame) >= usage + size - target)
+                    break;
+            }
+            if (base_mip != t.wanted_base_mip)
+                stats.deferred_request_count++;
+            if (base_mip < t.resident_base_mip) {
+                VkDeviceSize size = t.resident_sizes[base_mip] - t.resident_sizes[t.resident_base_mip];
+                if (set_base_mip(handle, base_mip))
+                    streamed += size;
+            }
+        }
+        current_frame.store(frame_index + 1, std::memory_order_relaxed);
+    }
+};
+
+}
@@ -0,0 +1,277 @@
+#pragma once
+#include "VKBase.h"
+#include "MpscQueue.h"
+#include <thread>
+
+namespace vulkan {
+
+/*
+一次提交的内容，相当于一个VkSubmitInfo加上可选的栅栏。
+数组直接存在结构体里，入队时整个拷贝，生产者在push后即可复用或销毁自己的数组。
+*/
+struct submission {
+    static constexpr uint32_t max_command_buffer_count = 8;
+    static constexpr uint32_t max_semaphore_count = 4;
+    VkCommandBuffer command_buffers[max_command_buffer_count];
+    uint32_t command_buffer_count = 0;
+    VkSemaphore wait_semaphores[max_semaphore_count];
+    VkPipelineStageFlags wait_dst_stage_masks[max_semaphore_count];
+    uint32_t wait_semaphore_count = 0;
+    VkSemaphore signal_semaphores[max_semaphore_count];
+    uint32_t signal_semaphore_count = 0;
+    VkFence fence = VK_NULL_HANDLE;
+
+    //数组已满时记录错误并忽略这次添加
+    submission& add_command_buffer(VkCommandBuffer commandBuffer) {
+        if (command_buffer_count == max_command_buffer_count) {
+            LogError("[ submission ] ERROR\nToo many command buffers in one submission! Max: {}\n", max_command_buffer_count);
+            return *this;
+        }
+        command_buffers[command_buffer_count++] = commandBuffer;
+        return *this;
+    }
+    submission& add_wait_semaphore(VkSemaphore semaphore, VkPipelineStageFlags waitDstStageMask) {
+        if (wait_semaphore_count == max_semaphore_count) {
+            LogError("[ submission ] ERROR\nToo many wait semaphores in one submission! Max: {}\n", max_semaphore_count);
+            return *this;
+        }
+        wait_semaphores[wait_semaphore_count] = semaphore;
+        wait_dst_stage_masks[wait_semaphore_count++] = waitDstStageMask;
+        return *this;
+    }
+    submission& add_signal_semaphore(VkSemaphore semaphore) {
+        if (signal_semaphore_count == max_semaphore_count) {
+            LogError("[ submission ] ERROR\nToo many signal semaphores in one submission! Max: {}\n", max_semaphore_count);
+            return *this;
+        }
+        signal_semaphores[signal_semaphore_count++] = semaphore;
+        return *this;
+    }
+};
+
+struct presentation {
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    uint32_t image_index = 0;
+    VkSemaphore wait_semaphores[submission::max_semaphore_count];
+    uint32_t wait_semaphore_count = 0;
+
+    presentation& add_wait_semaphore(VkSemaphore semaphore) {
+        if (wait_semaphore_count == submission::max_semaphore_count) {
+            LogError("[ presentation ] ERROR\nToo many wait semaphores in one presentation! Max: {}\n", submission::max_semaphore_count);
+            return *this;
+        }
+        wait_semaphores[wait_semaphore_count++] = semaphore;
+        return *this;
+    }
+};
+
+/*
+提交服务：独占一个VkQueue，由一个专门的线程调用vkQueueSubmit(...)和vkQueuePresentKHR(...)。
+Vulkan要求对队列的访问在外部同步，多个线程直接提交就得加一把全局锁，每次提交还有不小的驱动开销。
+这里生产者把请求推进无锁的MPSC队列，服务线程把连续的提交合并成一个VkSubmitInfo数组，用一次vkQueueSubmit(...)提交。
+合并遵循以下规则，以保持与逐个提交相同的语义：
+1.vkQueueSubmit(...)只能带一个栅栏，因此带栅栏的提交总是作为一批的最后一个，栅栏在这批全部完成后置位；
+2.呈现请求会先把之前积累的提交交出去，然后再呈现，保证顺序；
+3.请求按入队顺序处理，同一生产者的请求顺序不变。
+服务运行期间，其他线程不得直接访问该队列（包括vkQueueWaitIdle(...)和vkDeviceWaitIdle(...)），请改用wait_idle()。
+*/
+class submitService {
+public:
+    static constexpr uint32_t queue_capacity = 1024;
+    static constexpr uint32_t max_batch_size = 64;
+private:
+    struct request {
+        enum type_t : uint8_t {
+            submit,
+            present,
+            wait_idle
+        } type;
+        union {
+            submission submit_data;
+            presentation present_data;
+        };
+        //处理完后写入结果，可以为nullptr
+        std::atomic<VkResult>* pResult;
+        //wait_idle请求用来通知等待的线程
+        std::atomic<bool>* pDone;
+        request() :type(submit), submit_data(), pResult(nullptr), pDone(nullptr) {}
+    };
+    static_assert(std::is_trivially_copyable_v<submission> && std::is_trivially_copyable_v<presentation>);
+
+    VkQueue queue = VK_NULL_HANDLE;
+    mpscQueue<request, queue_capacity> requests;
+    std::thread thread;
+    std::atomic<bool> stop = false;
+    std::atomic<uint32_t> signal = 0;
+    std::atomic<uint32_t> sleeping = 0;
+    //统计：平均每次vkQueueSubmit(...)合并了多少个提交
+    std::atomic<uint64_t> submit_call_count = 0;
+    std::atomic<uint64_t> submission_count = 0;
+
+    //以下成员只在服务线程上访问
+    submission batch[max_batch_size];
+    std::atomic<VkResult>* batch_results[max_batch_size];
+    VkSubmitInfo submit_infos[max_batch_size];
+    uint32_t batch_size = 0;
+
+    void enqueue(const request& r) {
+        while (!requests.push(r)) {
+            //队列满了，唤醒服务线程并让出时间片
+            notify();
+            std::this_thread::yield();
+        }
+        notify();
+    }
+    void notify() {
+        signal.fetch_add(1, std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_seq_cst))
+            signal.notify_one();
+    }
+    void flush_batch() {
+        if (!batch_size)
+            return;
+        for (uint32_t i = 0; i < batch_size; i++) {
+            const submission& s = batch[i];
+            submit_infos[i] = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .waitSemaphoreCount = s.wait_semaphore_count,
+                .pWaitSemaphores = s.wait_semaphores,
+                .pWaitDstStageMask = s.wait_dst_stage_masks,
+                .commandBufferCount = s.command_buffer_count,
+                .pCommandBuffers = s.command_buffers,
+                .signalSemaphoreCount = s.signal_semaphore_count,
+                .pSignalSemaphores = s.signal_semaphores
+            };
+        }
+        VkResult result = graphics_base.dispatch.vkQueueSubmit(queue, batch_size, submit_infos, batch[batch_size - 1].fence);
+        if (result)
+            LogError("[ submitService ] ERROR\nFailed to submit {} submission(s) to the queue!\nError code: {}\n", batch_size, int32_t(result));
+        for (uint32_t i = 0; i < batch_size; i++)
+            if (batch_results[i])
+                batch_results[i]->store(result, std::memory_order_release);
+        submit_call_count.fetch_add(1, std::memory_order_relaxed);
+        submission_count.fetch_add(batch_size, std::memory_order_relaxed);
+        batch_size = 0;
+    }
+    void process(const request& r) {
+        switch (r.type) {
+        case request::submit:
+            batch[batch_size] = r.submit_data;
+            batch_results[batch_size++] = r.pResult;
+            if (r.submit_data.fence || batch_size == max_batch_size)
+                flush_batch();
+            break;
+        case request::present: {
+            flush_batch();
+            const presentation& p = r.present_data;
+            VkPresentInfoKHR presentInfo = {
+                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                .waitSemaphoreCount = p.wait_semaphore_count,
+                .pWaitSemaphores = p.wait_semaphores,
+                .swapchainCount = 1,
+                .pSwapchains = &p.swapchain,
+                .pImageIndices = &p.image_index
+            };
+            VkResult result = graphics_base.dispatch.vkQueuePresentKHR(queue, &presentInfo);
+            //VK_SUBOPTIMAL_KHR和VK_ERROR_OUT_OF_DATE_KHR交给调用者处理（重建交换链），不算错误
+            if (result < 0 && result != VK_ERROR_OUT_OF_DATE_KHR)
+                LogError("[ submitService ] ERROR\nFailed to present the image!\nError code: {}\n", int32_t(result));
+            if (r.pResult)
+                r.pResult->store(result, std::memory_order_release);
+            break;
+        }
+        case request::wait_idle: {
+            flush_batch();
+            VkResult result = graphics_base.dispatch.vkQueueWaitIdle(queue);
+            if (result)
+                LogError("[ submitService ] ERROR\nFailed to wait for the queue to be idle!\nError code: {}\n", int32_t(result));
+            if (r.pResult)
+                r.pResult->store(result, std::memory_order_release);
+            r.pDone->store(true, std::memory_order_release);
+            r.pDone->notify_all();
+            break;
+        }
+        }
+    }
+    void service_loop() {
+        while (true) {
+            uint32_t observed = signal.load(std::memory_order_seq_cst);
+            //把当前能拿到的请求全部处理掉，提交在队列暂时为空时才真正交出去，从而尽可能合并
+            bool any = false;
+            while (request* r = requests.front()) {
+                process(*r);
+                requests.pop_front();
+                any = true;
+            }
+            flush_batch();
+            if (any)
+                continue;
+            if (stop.load(std::memory_order_acquire))
+                break;
+            sleeping.fetch_add(1, std::memory_order_seq_cst);
+            signal.wait(observed, std::memory_order_seq_cst);
+            sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        }
+    }
+public:
+    submitService() = default;
+    submitService(VkQueue queue) {
+        start(queue);
+    }
+    submitService(submitService&&) = delete;
+    ~submitService() {
+        shutdown();
+    }
+    //Getter
+    VkQueue get_queue() const { return queue; }
+    //平均每次vkQueueSubmit(...)合并的提交数
+    double average_batch_size() const {
+        uint64_t calls = submit_call_count.load(std::memory_order_relaxed);
+        return calls ? double(submission_count.load(std::memory_order_relaxed)) / calls : 0;
+    }
+    //Const Function
+    //以下函数可在任意线程调用。pResult非空时，请求被处理后会写入其结果
+    void submit(const submission& submitInfo, std::atomic<VkResult>* pResult = nullptr) {
+        request r;
+        r.type = request::submit;
+        r.submit_data = submitInfo;
+        r.pResult = pResult;
+        enqueue(r);
+    }
+    void present(const presentation& presentInfo, std::atomic<VkResult>* pResult = nullptr) {
+        request r;
+        r.type = request::present;
+        r.present_data = presentInfo;
+        r.pResult = pResult;
+        enqueue(r);
+    }
+    //阻塞至此前入队的所有请求都已提交、且队列空闲
+    VkResult wait_idle() {
+        std::atomic<VkResult> result = VK_SUCCESS;
+        std::atomic<bool> done = false;
+        request r;
+        r.type = request::wait_idle;
+        r.pResult = &result;
+        r.pDone = &done;
+        enqueue(r);
+        done.wait(false, std::memory_order_acquire);
+        return result.load(std::memory_order_acquire);
+    }
+    //Non-const Function
+    void start(VkQueue queue) {
+        shutdown();
+        this->queue = queue;
+        stop.store(false, std::memory_order_relaxed);
+        thread = std::thread(&submitService::service_loop, this);
+    }
+    //处理完已入队的请求后结束服务线程，之后可以再次直接访问队列
+    void shutdown() {
+        if (!thread.joinable())
+            return;
+        stop.store(true, std::memory_order_release);
+        notify();
+        thread.join();
+    }
+};
+
+}
@@ -0,0 +1,237 @@
+#pragma once
+#include "VKBase.h"
+#include "JobSystem.h"
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SSE
+#include <emmintrin.h>
+#endif
+
+namespace vulkan {
+
+/*
+实例变换数据，以SoA（structure of arrays）形式存储平移、旋转（四元数）、缩放。
+每个分量一个数组，使得计算世界矩阵时能一次从各数组读取4个实例的同一分量，用SSE同时计算4个实例。
+各数组的长度总是向上对齐到simd_width，末尾多出的部分填充单位变换，这样SIMD循环不需要处理越界。
+*/
+class instanceTransforms {
+public:
+    static constexpr uint32_t simd_width = 4;
+private:
+    uint32_t count = 0;
+    //position[0..2]为xyz，rotation[0..3]为四元数的xyzw，scale[0..2]为xyz
+    std::vector<float> position[3];
+    std::vector<float> rotation[4];
+    std::vector<float> scale[3];
+
+    void resize_storage(uint32_t new_count) {
+        size_t padded = (new_count + simd_width - 1) / simd_width * simd_width;
+        for (auto& i : position)
+            i.resize(padded, 0.f);
+        for (int i = 0; i < 3; i++)
+            rotation[i].resize(padded, 0.f);
+        rotation[3].resize(padded, 1.f);
+        for (auto& i : scale)
+            i.resize(padded, 1.f);
+    }
+    //以下两个函数中的矩阵与glm::translate(p) * glm::mat4_cast(q) * glm::scale(s)相同
+    void update_scalar(uint32_t first, uint32_t end, glm::mat4* dst) const {
+        for (uint32_t i = first; i < end; i++) {
+            float qx = rotation[0][i], qy = rotation[1][i], qz = rotation[2][i], qw = rotation[3][i];
+            float sx = scale[0][i], sy = scale[1][i], sz = scale[2][i];
+            glm::mat4& m = dst[i];
+            m[0] = { (1 - 2 * (qy * qy + qz * qz)) * sx, 2 * (qx * qy + qw * qz) * sx, 2 * (qx * qz - qw * qy) * sx, 0 };
+            m[1] = { 2 * (qx * qy - qw * qz) * sy, (1 - 2 * (qx * qx + qz * qz)) * sy, 2 * (qy * qz + qw * qx) * sy, 0 };
+            m[2] = { 2 * (qx * qz + qw * qy) * sz, 2 * (qy * qz - qw * qx) * sz, (1 - 2 * (qx * qx + qy * qy)) * sz, 0 };
+            m[3] = { position[0][i], position[1][i], position[2][i], 1 };
+        }
+    }
+#ifdef TRANSFORM_SSE
+    //first须为simd_width的整数倍，每次计算4个实例，各矩阵元素先以“每通道一个实例”的形式算出，再转置写出
+    void update_sse(uint32_t first, uint32_t end, glm::mat4* dst) const {
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 two = _mm_set1_ps(2.f);
+        const __m128 zero = _mm_setzero_ps();
+        uint32_t i = first;
+        for (; i + simd_width <= end; i += simd_width) {
+            __m128 qx = _mm_loadu_ps(&rotation[0][i]), qy = _mm_loadu_ps(&rotation[1][i]);
+            __m128 qz = _mm_loadu_ps(&rotation[2][i]), qw = _mm_loadu_ps(&rotation[3][i]);
+            __m128 sx = _mm_loadu_ps(&scale[0][i]), sy = _mm_loadu_ps(&scale[1][i]), sz = _mm_loadu_ps(&scale[2][i]);
+            __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+            __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+            __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+            __m128 c[4][4] = {
+                {
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+                    zero
+                },
+                {
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+                    zero
+                },
+                {
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+                    _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+                    _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+                    zero
+                },
+                {
+                    _mm_loadu_ps(&position[0][i]),
+                    _mm_loadu_ps(&position[1][i]),
+                    _mm_loadu_ps(&position[2][i]),
+                    one
+                }
+            };
+            //转置后c[j][k]为第i + k个实例的第j列
+            for (auto& j : c)
+                _MM_TRANSPOSE4_PS(j[0], j[1], j[2], j[3]);
+            //按地址顺序写出，对write-combined的映射内存友好
+            for (uint32_t k = 0; k < simd_width; k++) {
+                float* m = &dst[i + k][0][0];
+                for (uint32_t j = 0; j < 4; j++)
+                    _mm_storeu_ps(m + j * 4, c[j][k]);
+            }
+        }
+        update_scalar(i, end, dst);
+    }
+#endif
+public:
+    instanceTransforms() = default;
+    instanceTransforms(uint32_t reserve_count) {
+        reserve(reserve_count);
+    }
+    //Getter
+    uint32_t size() const { return count; }
+    glm::vec3 get_position(uint32_t index) const { return { position[0][index], position[1][index], position[2][index] }; }
+    glm::quat get_rotation(uint32_t index) const { return glm::quat(rotation[3][index], rotation[0][index], rotation[1][index], rotation[2][index]); }
+    glm::vec3 get_scale(uint32_t index) const { return { scale[0][index], scale[1][index], scale[2][index] }; }
+    //直接访问SoA数组，用于需要批量修改某一分量的系统（如物理积分）
+    float* position_data(uint32_t component) { return position[component].data(); }
+    float* rotation_data(uint32_t component) { return rotation[component].data(); }
+    float* scale_data(uint32_t component) { return scale[component].data(); }
+    //Setter
+    void set_position(uint32_t index, const glm::vec3& value) {
+        position[0][index] = value.x, position[1][index] = value.y, position[2][index] = value.z;
+    }
+    void set_rotation(uint32_t index, const glm::quat& value) {
+        rotation[0][index] = value.x, rotation[1][index] = value.y, rotation[2][index] = value.z, rotation[3][index] = value.w;
+    }
+    void set_scale(uint32_t index, const glm::vec3& value) {
+        scale[0][index] = value.x, scale[1][index] = value.y, scale[2][index] = value.z;
+    }
+    //Non-const Function
+    void reserve(uint32_t reserve_count) {
+        size_t padded = (reserve_count + simd_width - 1) / simd_width * simd_width;
+        for (auto& i : position)
+            i.reserve(padded);
+        for (auto& i : rotation)
+            i.reserve(padded);
+        for (auto& i : scale)
+            i.reserve(padded);
+    }
+    //返回新实例的索引
+    uint32_t add(const glm::vec3& p = glm::vec3(0), const glm::quat& r = glm::quat(1, 0, 0, 0), const glm::vec3& s = glm::vec3(1)) {
+        resize_storage(count + 1);
+        set_position(count, p);
+        set_rotation(count, r);
+        set_scale(count, s);
+        return count++;
+    }
+    //将最后一个实例移到被删除的位置，返回被移动实例原先的索引（即删除前的size() - 1），以便调用者更新引用
+    uint32_t remove(uint32_t index) {
+        uint32_t last = --count;
+        set_position(index, get_position(last));
+        set_rotation(index, get_rotation(last));
+        set_scale(index, get_scale(last));
+        set_position(last, glm::vec3(0));
+        set_rotation(last, glm::quat(1, 0, 0, 0));
+        set_scale(last, glm::vec3(1));
+        resize_storage(count);
+        return last;
+    }
+    void clear() {
+        count = 0;
+        resize_storage(0);
+    }
+    //Const Function
+    //计算[first, first + range_count)中实例的世界矩阵并写入dst[first, ...)，dst可以是映射后的实例缓冲区
+    void update_range(uint32_t first, uint32_t range_count, glm::mat4* dst) const {
+        uint32_t end = std::min(first + range_count, count);
+#ifdef TRANSFORM_SSE
+        //开头不对齐的部分用标量处理
+        uint32_t aligned = std::min((first + simd_width - 1) / simd_width * simd_width, end);
+        update_scalar(first, aligned, dst);
+        update_sse(aligned, end, dst);
+#else
+        update_scalar(first, end, dst);
+#endif
+    }
+    //把所有实例分批交给调度器计算，counter归零后dst中的结果才完整
+    void update(glm::mat4* dst, jobSystem& job_system, jobCounter& counter) const {
+        //每批的实例数，须为simd_width的整数倍，太小的话调度开销会超过计算本身
+        static constexpr uint32_t batch_size = 4096;
+        for (uint32_t first = 0; first < count; first += batch_size)
+            job_system.run([this, dst, first] { update_range(first, batch_size, dst); }, &counter);
+    }
+};
+
+/*
+每个飞行中的帧一个实例缓冲区，创建后一直保持映射。
+当帧的栅栏置位后，直接把instanceTransforms::update(...)的结果写入data(frame_index)，再以逐实例顶点属性的方式绑定buffer(frame_index)。
+优先使用同时为DEVICE_LOCAL和HOST_VISIBLE的内存（如Resizable BAR），没有时回退到HOST_VISIBLE。
+*/
+class instanceBuffer {
+    std::vector<bufferMemory> buffers;
+    std::vector<glm::mat4*> mapped;
+    uint32_t instance_capacity = 0;
+public:
+    instanceBuffer() = default;
+    instanceBuffer(uint32_t capacity, uint32_t frame_count) {
+        create(capacity, frame_count);
+    }
+    instanceBuffer(instanceBuffer&& other) noexcept = default;
+    ~instanceBuffer() {
+        for (size_t i = 0; i < buffers.size(); i++)
+            if (mapped[i])
+                buffers[i].unmap_memory();
+    }
+    //Getter
+    uint32_t capacity() const { return instance_capacity; }
+    glm::mat4* data(uint32_t frame_index) const { return mapped[frame_index]; }
+    VkBuffer buffer(uint32_t frame_index) const { return buffers[frame_index].get_buffer(); }
+    //Const Function
+    //写完instance_count个实例后调用，对host coherent内存无操作
+    result_t flush(uint32_t frame_index, uint32_t instance_count) const {
+        return buffers[frame_index].flush(0, VkDeviceSize(instance_count) * sizeof(glm::mat4));
+    }
+    //Non-const Function
+    result_t create(uint32_t capacity, uint32_t frame_count,
+        VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        instance_capacity = capacity;
+        buffers.resize(frame_count);
+        mapped.resize(frame_count);
+        for (uint32_t i = 0; i < frame_count; i++) {
+            VkBufferCreateInfo bufferCreateInfo = {
+                .size = VkDeviceSize(capacity) * sizeof(glm::mat4),
+                .usage = usage
+            };
+            void* data;
+            VkResult result = buffers[i].create(bufferCreateInfo,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            result || (result = buffers[i].map_memory(data));
+            if (result) {
+                LogError("[ instanceBuffer ] ERROR\nFailed to create the instance buffer of frame {}!\nError code: {}\n", i, int32_t(result));
+                return result;
+            }
+            mapped[i] = static_cast<glm::mat4*>(data);
+        }
+        return VK_SUCCESS;
+    }
+};
+
+}
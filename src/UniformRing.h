@@ -0,0 +1,113 @@
+#pragma once
+#include "VKBase.h"
+#include <atomic>
+
+namespace vulkan {
+
+/*
+持久映射的动态uniform环形缓冲区。
+整个缓冲区按飞行中的帧数分成若干段，每帧只在自己那段里以minUniformBufferOffsetAlignment为单位往后分配，
+描述符以VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC类型、偏移量0、范围max_range写入一次即可，
+绘制时把allocate(...)返回的dynamic_offset传给vkCmdBindDescriptorSets(...)的pDynamicOffsets。
+于是每次绘制的常量上传只是一次原子加法加一次memcpy，不需要新建缓冲区或更新描述符。
+allocate(...)可在多个线程上同时调用（如并行录制命令时）。
+*/
+class uniformRingBuffer {
+public:
+    struct allocation {
+        void* data = nullptr; //映射后的地址，直接往这里写
+        uint32_t dynamic_offset = 0; //绑定描述符集时使用的动态偏移量
+    };
+private:
+    bufferMemory buffer_memory;
+    uint8_t* mapped = nullptr;
+    VkDeviceSize alignment = 1;
+    VkDeviceSize frame_size = 0; //每帧一段的大小，为alignment的整数倍
+    VkDeviceSize max_range = 0; //描述符的范围，即单次分配的最大大小
+    uint32_t frame_count = 0;
+    uint32_t current_frame = 0;
+    std::atomic<VkDeviceSize> offset = 0; //当前帧中已分配的字节数
+public:
+    uniformRingBuffer() = default;
+    uniformRingBuffer(VkDeviceSize size_per_frame, uint32_t frame_count, VkDeviceSize max_range = 0) {
+        create(size_per_frame, frame_count, max_range);
+    }
+    uniformRingBuffer(uniformRingBuffer&&) = delete;
+    ~uniformRingBuffer() {
+        if (mapped)
+            buffer_memory.unmap_memory();
+    }
+    //Getter
+    VkBuffer buffer() const { return buffer_memory.get_buffer(); }
+    VkDeviceSize range() const { return max_range; }
+    VkDeviceSize used_size() const { return offset.load(std::memory_order_relaxed); }
+    //用于写入VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC类型的描述符
+    VkDescriptorBufferInfo descriptor_info() const {
+        return { buffer_memory.get_buffer(), 0, max_range };
+    }
+    //Const Function
+    //在提交该帧的命令缓冲区前调用，只刷新本帧写入过的范围，host coherent内存无操作
+    result_t flush() const {
+        //溢出时offset会超过frame_size，只刷新实际写入的部分
+        VkDeviceSize size = std::min(offset.load(std::memory_order_acquire), frame_size);
+        if (!size)
+            return VK_SUCCESS;
+        return buffer_memory.flush(current_frame * frame_size, size);
+    }
+    //Non-const Function
+    //max_range为单次分配的最大大小，为0时取size_per_frame，且不超过maxUniformBufferRange
+    result_t create(VkDeviceSize size_per_frame, uint32_t frame_count, VkDeviceSize max_range = 0) {
+        const VkPhysicalDeviceLimits& limits = graphics_base.physical_device_properties.limits;
+        alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 1);
+        frame_size = (size_per_frame + alignment - 1) / alignment * alignment;
+        this->max_range = std::min<VkDeviceSize>(max_range ? max_range : frame_size, limits.maxUniformBufferRange);
+        this->frame_count = frame_count;
+        //末尾留出max_range的余量，保证任何动态偏移量加上描述符范围都不越界
+        VkBufferCreateInfo bufferCreateInfo = {
+            .size = frame_size * frame_count + this->max_range,
+            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+        };
+        void* data;
+        VkResult result = buffer_memory.create(bufferCreateInfo,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+        result || (result = buffer_memory.map_memory(data));
+        if (result) {
+            LogError("[ uniformRingBuffer ] ERROR\nFailed to create the uniform ring buffer!\nError code: {}\n", int32_t(result));
+            return result;
+        }
+        mapped = static_cast<uint8_t*>(data);
+        return VK_SUCCESS;
+    }
+    //须在frame_index对应帧的栅栏置位后调用，此后该段的旧数据可以覆盖
+    void begin_frame(uint32_t frame_index) {
+        current_frame = frame_index;
+        offset.store(0, std::memory_order_relaxed);
+    }
+    //分配失败（本帧的段已用尽或size超过max_range）时返回的data为nullptr
+    allocation allocate(VkDeviceSize size) {
+        if (size > max_range) {
+            LogError("[ uniformRingBuffer ] ERROR\nAllocation size {} exceeds the descriptor range {}!\n", size, max_range);
+            return {};
+        }
+        VkDeviceSize aligned_size = (size + alignment - 1) / alignment * alignment;
+        VkDeviceSize local_offset = offset.fetch_add(aligned_size, std::memory_order_relaxed);
+        if (local_offset + aligned_size > frame_size) {
+            LogError("[ uniformRingBuffer ] ERROR\nOut of uniform memory for this frame! Capacity: {}\n", frame_size);
+            return {};
+        }
+        VkDeviceSize absolute_offset = current_frame * frame_size + local_offset;
+        return { mapped + absolute_offset, uint32_t(absolute_offset) };
+    }
+    //拷贝data并返回动态偏移量，失败时返回UINT32_MAX
+    template<typename T>
+    uint32_t push(const T& data) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        allocation a = allocate(sizeof(T));
+        if (!a.data)
+            return UINT32_MAX;
+        std::memcpy(a.data, &data, sizeof(T));
+        return a.dynamic_offset;
+    }
+};
+
+}
@@ -1,14 +1,18 @@
 #pragma once
 #include "EasyVKStart.h"
+#include "Logger.h"
+#include "CallTrace.h"
 #include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <sys/types.h>
+#include <tuple>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 namespace vulkan {
-#define DestroyHandleBy(Func) if (handle) { Func(graphics_base.device, handle, nullptr); handle = VK_NULL_HANDLE; }
+#define DestroyHandleBy(Func) if (handle) { graphics_base.dispatch.Func(graphics_base.device, handle, nullptr); handle = VK_NULL_HANDLE; }
 #define MoveHandle handle = other.handle; other.handle = VK_NULL_HANDLE;
 #define DefineHandleTypeOperator operator auto() const { return handle; }
 #define DefineAddressFunction const auto Address() const { return &handle; }
@@ -51,14 +55,142 @@ struct [[nodiscard]] result_t {
 using result_t = VkResult;
 #endif
 
-inline auto& outStream = std::cout;//不是constexpr，因为std::cout具有外部链接
-
 constexpr VkExtent2D default_window_size = {
     .width = 1280,
     .height = 720 
 };
 
 
+/*
+设备级函数的X-macro列表。
+静态链接的加载器导出的vk*函数是“跳板”，要先按设备查到驱动的实现再跳转；
+用vkGetDeviceProcAddr(...)直接取得驱动的函数指针，每次调用可省去这一层间接。
+新用到的设备级函数须加进列表，并经由graphics_base.dispatch调用。
+*/
+#define VK_DEVICE_FUNCTIONS(X) \
+    X(vkDestroyDevice) \
+    X(vkDeviceWaitIdle) \
+    X(vkGetDeviceQueue) \
+    X(vkQueueSubmit) \
+    X(vkQueueWaitIdle) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkWaitForFences) \
+    X(vkResetFences) \
+    X(vkGetFenceStatus) \
+    X(vkCreateSemaphore) \
+    X(vkDestroySemaphore) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkFlushMappedMemoryRanges) \
+    X(vkInvalidateMappedMemoryRanges) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkGetBufferMemoryRequirements) \
+    X(vkBindBufferMemory) \
+    X(vkCreateImage) \
+    X(vkDestroyImage) \
+    X(vkGetImageMemoryRequirements) \
+    X(vkBindImageMemory) \
+    X(vkCreateImageView) \
+    X(vkDestroyImageView) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreatePipelineCache) \
+    X(vkDestroyPipelineCache) \
+    X(vkGetPipelineCacheData) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCreateGraphicsPipelines) \
+    X(vkCreateComputePipelines) \
+    X(vkDestroyPipeline) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkFreeCommandBuffers) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCmdCopyImageToBuffer) \
+    X(vkCmdClearColorImage)
+//随VK_KHR_swapchain提供，未启用该扩展（如无窗口运行）时为nullptr
+#define VK_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(X) \
+    X(vkCreateSwapchainKHR) \
+    X(vkDestroySwapchainKHR) \
+    X(vkGetSwapchainImagesKHR) \
+    X(vkQueuePresentKHR)
+
+struct deviceDispatchTable {
+#define DeclareDeviceFunction(name) PFN_##name name = nullptr;
+    VK_DEVICE_FUNCTIONS(DeclareDeviceFunction)
+    VK_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(DeclareDeviceFunction)
+#undef DeclareDeviceFunction
+
+    VkResult load(VkDevice device) {
+        VkResult result = VK_SUCCESS;
+#define LoadDeviceFunction(name) \
+        if (!(name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name)))) { \
+            LogError("[ deviceDispatchTable ] ERROR\nFailed to get the address of {}!\n", #name); \
+            result = VK_ERROR_INITIALIZATION_FAILED; \
+        }
+        VK_DEVICE_FUNCTIONS(LoadDeviceFunction)
+#undef LoadDeviceFunction
+#define LoadOptionalDeviceFunction(name) name = reinterpret_cast<PFN_##name>(vkGetDeviceProcAddr(device, #name));
+        VK_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(LoadOptionalDeviceFunction)
+#undef LoadOptionalDeviceFunction
+        return result;
+    }
+};
+
+#ifdef VK_TRACE_CALLS
+enum deviceFunctionIndex : uint32_t {
+#define DeclareDeviceFunctionIndex(name) index_##name,
+    VK_DEVICE_FUNCTIONS(DeclareDeviceFunctionIndex)
+    VK_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(DeclareDeviceFunctionIndex)
+#undef DeclareDeviceFunctionIndex
+    device_function_count
+};
+static_assert(device_function_count <= callTracer::max_function_count);
+//驱动的函数指针；追踪用的thunk须能转换为函数指针，不能捕获变量，因此经由这个全局变量调用
+inline deviceDispatchTable untraced_dispatch;
+//一次调用创建或销毁的对象数，批量的函数取其数量参数
+template<deviceFunctionIndex index, typename... Args>
+uint32_t traced_object_count(const Args&... args) {
+    std::tuple<const Args&...> arguments(args...);
+    if constexpr (index == index_vkAllocateCommandBuffers)
+        return std::get<1>(arguments)->commandBufferCount;
+    else if constexpr (index == index_vkFreeCommandBuffers ||
+        index == index_vkCreateGraphicsPipelines || index == index_vkCreateComputePipelines)
+        return std::get<2>(arguments);
+    else if constexpr (index == index_vkDestroyDevice)
+        return 0; //设备由vkCreateDevice(...)创建，不经过分发表，不计入
+    else
+        return 1;
+}
+//把table中已加载的函数换成计时并计数的thunk
+inline void install_call_tracing(deviceDispatchTable& table) {
+    static constexpr const char* names[] = {
+#define DeviceFunctionName(name) #name,
+        VK_DEVICE_FUNCTIONS(DeviceFunctionName)
+        VK_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(DeviceFunctionName)
+#undef DeviceFunctionName
+    };
+    call_tracer.set_functions(names);
+    untraced_dispatch = table;
+#define TraceDeviceFunction(name) \
+    if (table.name) \
+        table.name = [](auto... args) { \
+            scopedCallTimer timer(index_##name, traced_object_count<index_##name>(args...)); \
+            return untraced_dispatch.name(args...); \
+        };
+    VK_DEVICE_FUNCTIONS(TraceDeviceFunction)
+    VK_DEVICE_FUNCTIONS_KHR_SWAPCHAIN(TraceDeviceFunction)
+#undef TraceDeviceFunction
+}
+#endif
+
 class graphicsBase {
     public:
     uint32_t api_version = VK_API_VERSION_1_0;
@@ -76,6 +208,8 @@ class graphicsBase {
     std::vector<VkPhysicalDevice> available_physical_devices;
 
     VkDevice device;
+    //device的设备级函数，在create_device()中加载，设备重建后随之重新加载
+    deviceDispatchTable dispatch;
     // 有效的索引从0开始，因此使用特殊值VK_QUEUE_FAMILY_IGNORED（为UINT32_MAX）为队列族索引的默认值
     uint32_t queue_family_index_graphics = VK_QUEUE_FAMILY_IGNORED;
     uint32_t queue_family_index_presentation = VK_QUEUE_FAMILY_IGNORED;
@@ -115,15 +249,15 @@ class graphicsBase {
                 }
                 for(auto& i:swapchain_image_views) {
                     if(i)
-                        vkDestroyImageView(device, i, nullptr);
+                        dispatch.vkDestroyImageView(device, i, nullptr);
                 }
                 swapchain_image_views.resize(0);
-                vkDestroySwapchainKHR(device, swapchain, nullptr);
+                dispatch.vkDestroySwapchainKHR(device, swapchain, nullptr);
             }
             for(auto& i:callback_destroy_device) {
                 i();
             }
-            vkDestroyDevice(device, nullptr);
+            dispatch.vkDestroyDevice(device, nullptr);
         }
         if(surface)
             vkDestroySurfaceKHR(instance, surface, nullptr);
@@ -145,6 +279,46 @@ class graphicsBase {
     void add_device_extension(const char* extension) {
         add_layer_or_extension(device_extensions, extension);
     }
+    //若物理设备支持该扩展则将其加入device_extensions并返回true，须在determine_physical_device(...)之后、create_device(...)之前调用
+    bool add_device_extension_if_supported(const char* extension) {
+        uint32_t extension_count = 0;
+        if(VkResult result = vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, nullptr)) {
+            LogError("[ graphicsBase ] ERROR\nFailed to enumerate device extensions!\nError code: {}\n", int32_t(result));
+            return false;
+        }
+        std::vector<VkExtensionProperties> available_extensions(extension_count);
+        if(VkResult result = vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &extension_count, available_extensions.data())) {
+            LogError("[ graphicsBase ] ERROR\nFailed to enumerate device extensions!\nError code: {}\n", int32_t(result));
+            return false;
+        }
+        for(auto& i:available_extensions) {
+            if(!std::strcmp(i.extensionName, extension)) {
+                add_device_extension(extension);
+                return true;
+            }
+        }
+        return false;
+    }
+    bool is_instance_extension_enabled(const char* extension) const {
+        return std::find_if(instance_extensions.begin(), instance_extensions.end(), [extension](const char* str) {
+            return std::strcmp(str, extension) == 0;}) != instance_extensions.end();
+    }
+    /*
+    返回可用的vkGetPhysicalDeviceMemoryProperties2(...)的名称，VK_EXT_memory_budget依赖于它：
+    实例和物理设备均支持Vulkan 1.1时为核心版本，否则启用了VK_KHR_get_physical_device_properties2时为KHR版本，都不满足时返回nullptr。
+    须在determine_physical_device(...)之后调用。
+    */
+    const char* physical_device_memory_properties2_name() const {
+        if(api_version >= VK_API_VERSION_1_1 && physical_device_properties.apiVersion >= VK_API_VERSION_1_1)
+            return "vkGetPhysicalDeviceMemoryProperties2";
+        if(is_instance_extension_enabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME))
+            return "vkGetPhysicalDeviceMemoryProperties2KHR";
+        return nullptr;
+    }
+    bool is_device_extension_enabled(const char* extension) const {
+        return std::find_if(device_extensions.begin(), device_extensions.end(), [extension](const char* str) {
+            return std::strcmp(str, extension) == 0;}) != device_extensions.end();
+    }
 
     VkResult use_latest_version() {
         if (vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion"))
@@ -172,11 +346,11 @@ class graphicsBase {
             .ppEnabledExtensionNames = instance_extensions.data()
         };
         if (VkResult result = vkCreateInstance(&instanceCreateInfo, nullptr, &instance)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to create a vulkan instance!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to create a vulkan instance!\nError code: {}\n", int32_t(result));
             return result;
         }
         //成功创建Vulkan实例后，输出Vulkan版本
-        outStream << std::format(
+        LogInfo(
         "Vulkan API Version: {}.{}.{}\n",
         VK_VERSION_MAJOR(api_version),
         VK_VERSION_MINOR(api_version),
@@ -194,7 +368,11 @@ class graphicsBase {
             VkDebugUtilsMessageTypeFlagsEXT messageTypes,
             const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
             void* pUserData)->VkBool32 {
-                outStream << std::format("{}\n\n", pCallbackData->pMessage);
+                //验证层的消息可能很长且成批出现，同步输出，不截断也不限频
+                if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+                    LogErrorSync("{}\n\n", pCallbackData->pMessage);
+                else
+                    LogWarningSync("{}\n\n", pCallbackData->pMessage);
                 // 文档说必须返回VK_FALSE,VK_TRUE留作其他用处
                 return VK_FALSE;
         };
@@ -214,10 +392,10 @@ class graphicsBase {
         if (vkCreateDebugUtilsMessenger) {
             VkResult result = vkCreateDebugUtilsMessenger(instance, &debugUtilsMessengerCreateInfo, nullptr, &debug_messenger);
             if (result)
-                outStream << std::format("[ graphicsBase ] ERROR\nFailed to create a debug messenger!\nError code: {}\n", int32_t(result));
+                LogError("[ graphicsBase ] ERROR\nFailed to create a debug messenger!\nError code: {}\n", int32_t(result));
             return result;
         }
-        outStream << std::format("[ graphicsBase ] ERROR\nFailed to get the function pointer of vkCreateDebugUtilsMessengerEXT!\n");
+        LogError("[ graphicsBase ] ERROR\nFailed to get the function pointer of vkCreateDebugUtilsMessengerEXT!\n");
         return VK_RESULT_MAX_ENUM;
     }
 
@@ -225,19 +403,19 @@ class graphicsBase {
         std::vector<VkLayerProperties> available_layers;
         uint32_t layer_count;
         if(VkResult result = vkEnumerateInstanceLayerProperties(&layer_count, nullptr)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to enumerate instance layers!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to enumerate instance layers!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(layer_count){
             available_layers.resize(layer_count);
             if(VkResult result = vkEnumerateInstanceLayerProperties(&layer_count, available_layers.data())) {
-                outStream << std::format("[ graphicsBase ] ERROR\nFailed to enumerate instance layers!\nError code: {}\n", int32_t(result));
+                LogError("[ graphicsBase ] ERROR\nFailed to enumerate instance layers!\nError code: {}\n", int32_t(result));
                 return result;
             }
             for(auto& i:layer_to_check ){
                 if(std::find_if(available_layers.begin(), available_layers.end(), [i](const VkLayerProperties& layer) {
                     return std::strcmp(layer.layerName, i) == 0;}) == available_layers.end()){
-                    outStream << std::format("[ graphicsBase ] ERROR\nLayer {} not found!\n", i);
+                    LogError("[ graphicsBase ] ERROR\nLayer {} not found!\n", i);
                     i = nullptr;
                 }
             }
@@ -253,21 +431,22 @@ class graphicsBase {
         std::vector<VkExtensionProperties> available_extensions;
         uint32_t extension_count;
         if(VkResult result = vkEnumerateInstanceExtensionProperties(layer_name, &extension_count, nullptr)) {
-            layer_name ? 
-            outStream<< std::format("[ graphicsBase ] ERROR\nFailed to enumerate instance extensions for layer {}!\nError code: {}\n", layer_name, int32_t(result)) :
-            outStream<< std::format("[ graphicsBase ] ERROR\nFailed to enumerate instance extensions!\nError code: {}\n", int32_t(result));
+            if (layer_name)
+                LogError("[ graphicsBase ] ERROR\nFailed to enumerate instance extensions for layer {}!\nError code: {}\n", layer_name, int32_t(result));
+            else
+                LogError("[ graphicsBase ] ERROR\nFailed to enumerate instance extensions!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(extension_count){
             available_extensions.resize(extension_count);
             if(VkResult result = vkEnumerateInstanceExtensionProperties(nullptr, &extension_count, available_extensions.data())) {
-                outStream << std::format("[ graphicsBase ] ERROR\nFailed to enumerate instance extensions!\nError code: {}\n", int32_t(result));
+                LogError("[ graphicsBase ] ERROR\nFailed to enumerate instance extensions!\nError code: {}\n", int32_t(result));
                 return result;
             }
             for(auto& i:extension_to_check ){
                 if(std::find_if(available_extensions.begin(), available_extensions.end(), [i](const VkExtensionProperties& extension) {
                     return std::strcmp(extension.extensionName, i) == 0;}) == available_extensions.end()){
-                    outStream << std::format("[ graphicsBase ] ERROR\nExtension {} not found!\n", i);
+                    LogError("[ graphicsBase ] ERROR\nExtension {} not found!\n", i);
                     i = nullptr;
                 }
             }
@@ -282,17 +461,18 @@ class graphicsBase {
     VkResult get_physical_devices() {
         uint32_t device_count;
         if(VkResult result = vkEnumeratePhysicalDevices(instance, &device_count, nullptr)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to enumerate physical devices!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to enumerate physical devices!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(!device_count){
-            outStream << std::format("[ graphicsBase ] ERROR\nNo physical devices found!\n");
+            LogError("[ graphicsBase ] ERROR\nNo physical devices found!\n");
+            logger.flush();
             abort();
         }
         available_physical_devices.resize(device_count);
         VkResult result = vkEnumeratePhysicalDevices(instance, &device_count, available_physical_devices.data());
         if(result) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to enumerate physical devices!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to enumerate physical devices!\nError code: {}\n", int32_t(result));
         }
         return result;
     }
@@ -337,6 +517,9 @@ class graphicsBase {
             queue_family_index_presentation = surface ? ip : VK_QUEUE_FAMILY_IGNORED;
         }
         physical_device = available_physical_devices[device_index];
+        //在create_device()之前取得，以便据此决定启用哪些扩展（如VK_EXT_memory_budget需要物理设备支持Vulkan 1.1）
+        vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &physical_device_memory_properties);
         return VK_SUCCESS;
     }
     
@@ -384,18 +567,27 @@ class graphicsBase {
             .pEnabledFeatures = &device_features
         };
         if(VkResult result = vkCreateDevice(physical_device, &deviceCreateInfo, nullptr, &device)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to create a device!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to create a device!\nError code: {}\n", int32_t(result));
             return result;
         }
+        if(VkResult result = dispatch.load(device)) {
+            LogError("[ graphicsBase ] ERROR\nFailed to load device-level functions!\nError code: {}\n", int32_t(result));
+            //分发表不完整，经由加载器销毁设备，使析构器和各封装类不会调用空的函数指针
+            vkDestroyDevice(device, nullptr);
+            device = VK_NULL_HANDLE;
+            dispatch = {};
+            return result;
+        }
+    #ifdef VK_TRACE_CALLS
+        install_call_tracing(dispatch);
+    #endif
         if(queue_family_index_graphics != VK_QUEUE_FAMILY_IGNORED) 
-            vkGetDeviceQueue(device, queue_family_index_graphics, 0, &queue_graphics);
+            dispatch.vkGetDeviceQueue(device, queue_family_index_graphics, 0, &queue_graphics);
         if(queue_family_index_compute != VK_QUEUE_FAMILY_IGNORED) 
-            vkGetDeviceQueue(device, queue_family_index_compute, 0, &queue_compute);
+            dispatch.vkGetDeviceQueue(device, queue_family_index_compute, 0, &queue_compute);
         if(queue_family_index_presentation != VK_QUEUE_FAMILY_IGNORED)
-            vkGetDeviceQueue(device, queue_family_index_presentation, 0, &queue_presentation);
-        vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
-        vkGetPhysicalDeviceMemoryProperties(physical_device, &physical_device_memory_properties);
-        outStream << std::format(
+            dispatch.vkGetDeviceQueue(device, queue_family_index_presentation, 0, &queue_presentation);
+        LogInfo(
             "Physical Device: {}\n",
             physical_device_properties.deviceName);
         for(auto& i:callback_create_device) {
@@ -407,7 +599,7 @@ class graphicsBase {
     VkResult create_swapchain(bool limit_frame_rate = true,VkSwapchainCreateFlagsKHR flags = 0){
         VkSurfaceCapabilitiesKHR surface_capabilities;
         if(VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &surface_capabilities)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface capabilities!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface capabilities!\nError code: {}\n", int32_t(result));
             return result;
         }
         swapchain_create_info.minImageCount = surface_capabilities.minImageCount + (surface_capabilities.maxImageCount > 0 ? 1 : 0);
@@ -433,33 +625,34 @@ class graphicsBase {
         if(surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
             swapchain_create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
         else
-            outStream<< std::format("[ graphicsBase ] WARNING\nSwapchain image usage flags are not supported!\n");
+            LogWarning("[ graphicsBase ] WARNING\nSwapchain image usage flags are not supported!\n");
         if(available_surface_formats.empty()){
             if(VkResult result = get_surface_formats()) {
-                outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface formats!\nError code: {}\n", int32_t(result));
+                LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface formats!\nError code: {}\n", int32_t(result));
                 return result;
             }
         }
         if(!swapchain_create_info.imageFormat){
             if(set_surface_formats({VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR}) &&
                 set_surface_formats({VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR})){
-                    outStream << std::format("[ graphicsBase ] WARNING\nSwapchain image format not supported!\n");
+                    LogWarning("[ graphicsBase ] WARNING\nSwapchain image format not supported!\n");
                     swapchain_create_info.imageFormat = available_surface_formats[0].format;
                     swapchain_create_info.imageColorSpace = available_surface_formats[0].colorSpace;
             }
         }
         uint32_t surface_present_mode_count;
         if(VkResult result = vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &surface_present_mode_count, nullptr)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface present modes!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface present modes!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(!surface_present_mode_count){
-            outStream << std::format("[ graphicsBase ] ERROR\nNo surface present modes found!\n");
+            LogError("[ graphicsBase ] ERROR\nNo surface present modes found!\n");
+            logger.flush();
             abort();
         }
         std::vector<VkPresentModeKHR> surface_present_modes(surface_present_mode_count);
         if(VkResult result = vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface, &surface_present_mode_count, surface_present_modes.data())) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface present modes!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface present modes!\nError code: {}\n", int32_t(result));
             return result;
         }
         swapchain_create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
@@ -477,7 +670,7 @@ class graphicsBase {
         swapchain_create_info.flags = flags;
         swapchain_create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
         if(VkResult result = create_swapchain_internal()) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to create swapchain!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to create swapchain!\nError code: {}\n", int32_t(result));
             return result;
         }
         for(auto& i:callback_create_swapchain) {
@@ -490,19 +683,19 @@ class graphicsBase {
     VkResult recreate_swapchain() {
         VkSurfaceCapabilitiesKHR surface_capabilities;
         if(VkResult result = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, surface, &surface_capabilities)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface capabilities!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface capabilities!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(surface_capabilities.currentExtent.width == -1 || surface_capabilities.currentExtent.height == -1) 
             return VK_SUBOPTIMAL_KHR;
         swapchain_create_info.imageExtent = surface_capabilities.currentExtent;
         swapchain_create_info.oldSwapchain = swapchain;
-        VkResult result = vkQueueWaitIdle(queue_graphics);
+        VkResult result = dispatch.vkQueueWaitIdle(queue_graphics);
         if(!result || queue_graphics != queue_presentation) {
-            result = vkQueueWaitIdle(queue_presentation);
+            result = dispatch.vkQueueWaitIdle(queue_presentation);
         } 
         if(result) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to wait for queue idle!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to wait for queue idle!\nError code: {}\n", int32_t(result));
             return result;
         }
         for(auto& i:callback_destroy_swapchain) {
@@ -510,11 +703,11 @@ class graphicsBase {
         }
         for(auto& i:swapchain_image_views) {
             if(i)
-                vkDestroyImageView(device, i, nullptr);
+                dispatch.vkDestroyImageView(device, i, nullptr);
         }
         swapchain_image_views.resize(0);
         if(result = create_swapchain_internal();result) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to recreate swapchain!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to recreate swapchain!\nError code: {}\n", int32_t(result));
             return result;
         }
         for(auto& i:callback_create_swapchain) {
@@ -525,7 +718,7 @@ class graphicsBase {
 
     VkResult recreate_device(VkDeviceCreateFlags flags = 0) {
         if(VkResult result = wait_idle()) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to wait for device idle!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to wait for device idle!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(swapchain) {
@@ -534,25 +727,26 @@ class graphicsBase {
             }
             for(auto& i:swapchain_image_views) {
                 if(i)
-                    vkDestroyImageView(device, i, nullptr);
+                    dispatch.vkDestroyImageView(device, i, nullptr);
             }
             swapchain_image_views.resize(0);
-            vkDestroySwapchainKHR(device, swapchain, nullptr);
+            dispatch.vkDestroySwapchainKHR(device, swapchain, nullptr);
             swapchain = VK_NULL_HANDLE;
             swapchain_create_info = {};
         }
         for(auto& i:callback_destroy_device) {
             i();
         }
-        vkDestroyDevice(device, nullptr);
+        dispatch.vkDestroyDevice(device, nullptr);
         device = VK_NULL_HANDLE;
+        dispatch = {};
         return create_device(flags);
     }
 
     VkResult wait_idle() const {
-        VkResult result = vkDeviceWaitIdle(device);
+        VkResult result = dispatch.vkDeviceWaitIdle(device);
         if(result) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to wait for device idle!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to wait for device idle!\nError code: {}\n", int32_t(result));
         }
         return result;
     }
@@ -581,7 +775,7 @@ class graphicsBase {
             }
         }
         if(!format_available) {
-            outStream << std::format("[ graphicsBase ] ERROR\nSurface format not supported!\n");
+            LogError("[ graphicsBase ] ERROR\nSurface format not supported!\n");
             return VK_ERROR_FORMAT_NOT_SUPPORTED;
         }
         if(swapchain){
@@ -591,22 +785,23 @@ class graphicsBase {
     }
 
     VkResult create_swapchain_internal() {
-        if(VkResult result = vkCreateSwapchainKHR(device, &swapchain_create_info, nullptr, &swapchain)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to create swapchain!\nError code: {}\n", int32_t(result));
+        if(VkResult result = dispatch.vkCreateSwapchainKHR(device, &swapchain_create_info, nullptr, &swapchain)) {
+            LogError("[ graphicsBase ] ERROR\nFailed to create swapchain!\nError code: {}\n", int32_t(result));
             return result;
         }
         uint32_t swapchain_image_count;
-        if(VkResult result = vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count, nullptr)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get swapchain images!\nError code: {}\n", int32_t(result));
+        if(VkResult result = dispatch.vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count, nullptr)) {
+            LogError("[ graphicsBase ] ERROR\nFailed to get swapchain images!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(!swapchain_image_count){
-            outStream << std::format("[ graphicsBase ] ERROR\nNo swapchain images found!\n");
+            LogError("[ graphicsBase ] ERROR\nNo swapchain images found!\n");
+            logger.flush();
             abort();
         }
         swapchain_images.resize(swapchain_image_count);
-        if(VkResult result = vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count, swapchain_images.data())) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get swapchain images!\nError code: {}\n", int32_t(result));
+        if(VkResult result = dispatch.vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count, swapchain_images.data())) {
+            LogError("[ graphicsBase ] ERROR\nFailed to get swapchain images!\nError code: {}\n", int32_t(result));
             return result;
         }
         swapchain_image_views.resize(swapchain_image_count);
@@ -630,8 +825,8 @@ class graphicsBase {
         };
         for(uint32_t i = 0; i < swapchain_image_count; i++) {
             swapchain_image_view_create_info.image = swapchain_images[i];
-            if(VkResult result = vkCreateImageView(device, &swapchain_image_view_create_info, nullptr, &swapchain_image_views[i])) {
-                outStream << std::format("[ graphicsBase ] ERROR\nFailed to create swapchain image view!\nError code: {}\n", int32_t(result));
+            if(VkResult result = dispatch.vkCreateImageView(device, &swapchain_image_view_create_info, nullptr, &swapchain_image_views[i])) {
+                LogError("[ graphicsBase ] ERROR\nFailed to create swapchain image view!\nError code: {}\n", int32_t(result));
                 return result;
             }
         }
@@ -648,17 +843,18 @@ class graphicsBase {
     VkResult get_surface_formats() {
         uint32_t format_count;
         if(VkResult result = vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, nullptr)) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface formats!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface formats!\nError code: {}\n", int32_t(result));
             return result;
         }
         if(!format_count){
-            outStream << std::format("[ graphicsBase ] ERROR\nNo surface formats found!\n");
+            LogError("[ graphicsBase ] ERROR\nNo surface formats found!\n");
+            logger.flush();
             abort();
         }
         available_surface_formats.resize(format_count);
         VkResult result = vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count, available_surface_formats.data());
         if(result) {
-            outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface formats!\nError code: {}\n", int32_t(result));
+            LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface formats!\nError code: {}\n", int32_t(result));
         }
         return result;
     }
@@ -666,7 +862,7 @@ class graphicsBase {
         uint32_t queue_family_count=0;
         vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
         if(!queue_family_count){
-            outStream << std::format("[ graphicsBase ] ERROR\nNo queue family found!\n");
+            LogError("[ graphicsBase ] ERROR\nNo queue family found!\n");
             return VK_RESULT_MAX_ENUM;
         }
         std::vector<VkQueueFamilyProperties> queue_family_properties(queue_family_count);
@@ -680,7 +876,7 @@ class graphicsBase {
 
             if(surface) {
                 if(VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, surface, &support_presentation)) {
-                    outStream << std::format("[ graphicsBase ] ERROR\nFailed to get physical device surface support!\nError code: {}\n", int32_t(result));
+                    LogError("[ graphicsBase ] ERROR\nFailed to get physical device surface support!\nError code: {}\n", int32_t(result));
                     return result;
                 }
             }
@@ -741,15 +937,15 @@ public:
     DefineAddressFunction;
     //Const Function
     result_t wait() const {
-        VkResult result = vkWaitForFences(graphics_base.device, 1, &handle, false, UINT64_MAX);
+        VkResult result = graphics_base.dispatch.vkWaitForFences(graphics_base.device, 1, &handle, false, UINT64_MAX);
         if (result)
-            outStream << std::format("[ fence ] ERROR\nFailed to wait for the fence!\nError code: {}\n", int32_t(result));
+            LogError("[ fence ] ERROR\nFailed to wait for the fence!\nError code: {}\n", int32_t(result));
         return result;
     }
     result_t reset() const {
-        VkResult result = vkResetFences(graphics_base.device, 1, &handle);
+        VkResult result = graphics_base.dispatch.vkResetFences(graphics_base.device, 1, &handle);
         if (result)
-            outStream << std::format("[ fence ] ERROR\nFailed to reset the fence!\nError code: {}\n", int32_t(result));
+            LogError("[ fence ] ERROR\nFailed to reset the fence!\nError code: {}\n", int32_t(result));
         return result;
     }
     //因为“等待后立刻重置”的情形经常出现，定义此函数
@@ -759,17 +955,17 @@ public:
         return result;
     }
     result_t status() const {
-        VkResult result = vkGetFenceStatus(graphics_base.device, handle);
+        VkResult result = graphics_base.dispatch.vkGetFenceStatus(graphics_base.device, handle);
         if (result < 0) //vkGetFenceStatus(...)成功时有两种结果，所以不能仅仅判断result是否非0
-            outStream << std::format("[ fence ] ERROR\nFailed to get the status of the fence!\nError code: {}\n", int32_t(result));
+            LogError("[ fence ] ERROR\nFailed to get the status of the fence!\nError code: {}\n", int32_t(result));
         return result;
     }
     //Non-const Function
     result_t create(VkFenceCreateInfo& createInfo) {
         createInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        VkResult result = vkCreateFence(graphics_base.device, &createInfo, nullptr, &handle);
+        VkResult result = graphics_base.dispatch.vkCreateFence(graphics_base.device, &createInfo, nullptr, &handle);
         if (result)
-            outStream << std::format("[ fence ] ERROR\nFailed to create a fence!\nError code: {}\n", int32_t(result));
+            LogError("[ fence ] ERROR\nFailed to create a fence!\nError code: {}\n", int32_t(result));
         return result;
     }
     result_t create(VkFenceCreateFlags flags = 0) {
@@ -799,9 +995,9 @@ public:
     //Non-const Function
     result_t create(VkSemaphoreCreateInfo& createInfo) {
         createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-        VkResult result = vkCreateSemaphore(graphics_base.device, &createInfo, nullptr, &handle);
+        VkResult result = graphics_base.dispatch.vkCreateSemaphore(graphics_base.device, &createInfo, nullptr, &handle);
         if (result)
-            outStream << std::format("[ semaphore ] ERROR\nFailed to create a semaphore!\nError code: {}\n", int32_t(result));
+            LogError("[ semaphore ] ERROR\nFailed to create a semaphore!\nError code: {}\n", int32_t(result));
         return result;
     }
     result_t create(/*VkSemaphoreCreateFlags flags*/) {
@@ -810,5 +1006,481 @@ public:
     }
 };
 
+class deviceMemory {
+    VkDeviceMemory handle = VK_NULL_HANDLE;
+    VkDeviceSize allocation_size = 0; //实际分配的内存大小
+    VkMemoryPropertyFlags memory_properties = 0; //内存属性
+    //把非host coherent内存的映射范围扩展到nonCoherentAtomSize的整数倍
+    void align_non_coherent_range(VkDeviceSize& offset, VkDeviceSize& size) const {
+        const VkDeviceSize atom = graphics_base.physical_device_properties.limits.nonCoherentAtomSize;
+        VkDeviceSize begin = offset / atom * atom;
+        if (size != VK_WHOLE_SIZE)
+            size = std::min((offset + size + atom - 1) / atom * atom, allocation_size) - begin;
+        offset = begin;
+    }
+public:
+    deviceMemory() = default;
+    deviceMemory(VkMemoryAllocateInfo& allocateInfo) {
+        allocate(allocateInfo);
+    }
+    deviceMemory(deviceMemory&& other) noexcept {
+        MoveHandle;
+        allocation_size = other.allocation_size;
+        memory_properties = other.memory_properties;
+        other.allocation_size = 0;
+        other.memory_properties = 0;
+    }
+    ~deviceMemory() { DestroyHandleBy(vkFreeMemory); allocation_size = 0; memory_properties = 0; }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    VkDeviceSize size() const { return allocation_size; }
+    VkMemoryPropertyFlags properties() const { return memory_properties; }
+    //Const Function
+    //映射host visible的内存区，对非host coherent内存会在映射后invalidate
+    result_t map_memory(void*& data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0) const {
+        VkDeviceSize aligned_offset = offset;
+        if (!(memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+            align_non_coherent_range(aligned_offset, size);
+        if (VkResult result = graphics_base.dispatch.vkMapMemory(graphics_base.device, handle, aligned_offset, size, 0, &data)) {
+            LogError("[ deviceMemory ] ERROR\nFailed to map the memory!\nError code: {}\n", int32_t(result));
+            return result;
+        }
+        data = static_cast<uint8_t*>(data) + (offset - aligned_offset);
+        return invalidate(aligned_offset, size);
+    }
+    result_t unmap_memory() const {
+        graphics_base.dispatch.vkUnmapMemory(graphics_base.device, handle);
+        return VK_SUCCESS;
+    }
+    //将主机写入的范围对设备可见，host coherent内存无需此操作
+    result_t flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const {
+        if (memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+            return VK_SUCCESS;
+        align_non_coherent_range(offset, size);
+        VkMappedMemoryRange mappedMemoryRange = {
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = handle,
+            .offset = offset,
+            .size = size
+        };
+        VkResult result = graphics_base.dispatch.vkFlushMappedMemoryRanges(graphics_base.device, 1, &mappedMemoryRange);
+        if (result)
+            LogError("[ deviceMemory ] ERROR\nFailed to flush the memory!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    //将设备写入的范围对主机可见，host coherent内存无需此操作
+    result_t invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) const {
+        if (memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+            return VK_SUCCESS;
+        align_non_coherent_range(offset, size);
+        VkMappedMemoryRange mappedMemoryRange = {
+            .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .memory = handle,
+            .offset = offset,
+            .size = size
+        };
+        VkResult result = graphics_base.dispatch.vkInvalidateMappedMemoryRanges(graphics_base.device, 1, &mappedMemoryRange);
+        if (result)
+            LogError("[ deviceMemory ] ERROR\nFailed to invalidate the memory!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    //Non-const Function
+    result_t allocate(VkMemoryAllocateInfo& allocateInfo) {
+        if (allocateInfo.memoryTypeIndex >= graphics_base.physical_device_memory_properties.memoryTypeCount) {
+            LogError("[ deviceMemory ] ERROR\nInvalid memory type index!\n");
+            return VK_RESULT_MAX_ENUM;
+        }
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        if (VkResult result = graphics_base.dispatch.vkAllocateMemory(graphics_base.device, &allocateInfo, nullptr, &handle)) {
+            LogError("[ deviceMemory ] ERROR\nFailed to allocate memory!\nError code: {}\n", int32_t(result));
+            return result;
+        }
+        allocation_size = allocateInfo.allocationSize;
+        memory_properties = graphics_base.physical_device_memory_properties.memoryTypes[allocateInfo.memoryTypeIndex].propertyFlags;
+        return VK_SUCCESS;
+    }
+    //根据内存需求选择内存类型并分配；若找不到同时满足的类型，会去掉DEVICE_LOCAL再试一次
+    result_t allocate(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags desired_memory_properties) {
+        auto& memory_types = graphics_base.physical_device_memory_properties;
+        for (VkMemoryPropertyFlags flags : { desired_memory_properties, desired_memory_properties & ~VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) }) {
+            for (uint32_t i = 0; i < memory_types.memoryTypeCount; i++) {
+                if (memoryRequirements.memoryTypeBits & 1 << i &&
+                    (memory_types.memoryTypes[i].propertyFlags & flags) == flags) {
+                    VkMemoryAllocateInfo allocateInfo = {
+                        .allocationSize = memoryRequirements.size,
+                        .memoryTypeIndex = i
+                    };
+                    return allocate(allocateInfo);
+                }
+            }
+        }
+        LogError("[ deviceMemory ] ERROR\nFailed to find any memory type satisfies all desired memory properties!\n");
+        return VK_RESULT_MAX_ENUM;
+    }
+};
+
+class buffer {
+    VkBuffer handle = VK_NULL_HANDLE;
+public:
+    buffer() = default;
+    buffer(VkBufferCreateInfo& createInfo) {
+        create(createInfo);
+    }
+    buffer(buffer&& other) noexcept { MoveHandle; }
+    ~buffer() { DestroyHandleBy(vkDestroyBuffer); }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Const Function
+    VkMemoryRequirements memory_requirements() const {
+        VkMemoryRequirements memoryRequirements;
+        graphics_base.dispatch.vkGetBufferMemoryRequirements(graphics_base.device, handle, &memoryRequirements);
+        return memoryRequirements;
+    }
+    result_t bind_memory(VkDeviceMemory deviceMemory, VkDeviceSize memoryOffset = 0) const {
+        VkResult result = graphics_base.dispatch.vkBindBufferMemory(graphics_base.device, handle, deviceMemory, memoryOffset);
+        if (result)
+            LogError("[ buffer ] ERROR\nFailed to attach the memory!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    //Non-const Function
+    result_t create(VkBufferCreateInfo& createInfo) {
+        createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreateBuffer(graphics_base.device, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ buffer ] ERROR\nFailed to create a buffer!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+};
+
+//缓冲区及其独占的设备内存，析构时先销毁缓冲区再释放内存
+class bufferMemory :deviceMemory, buffer {
+public:
+    bufferMemory() = default;
+    bufferMemory(VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags desired_memory_properties) {
+        create(createInfo, desired_memory_properties);
+    }
+    bufferMemory(bufferMemory&& other) noexcept :
+        deviceMemory(std::move(other)), buffer(std::move(other)) {}
+    //Getter
+    VkBuffer get_buffer() const { return static_cast<const buffer&>(*this); }
+    const VkBuffer* address_of_buffer() const { return buffer::Address(); }
+    VkDeviceMemory get_memory() const { return static_cast<const deviceMemory&>(*this); }
+    using deviceMemory::size;
+    using deviceMemory::properties;
+    //Const Function
+    using deviceMemory::map_memory;
+    using deviceMemory::unmap_memory;
+    using deviceMemory::flush;
+    using deviceMemory::invalidate;
+    //Non-const Function
+    result_t create(VkBufferCreateInfo& createInfo, VkMemoryPropertyFlags desired_memory_properties) {
+        VkResult result = buffer::create(createInfo);
+        result || (result = deviceMemory::allocate(memory_requirements(), desired_memory_properties));
+        result || (result = bind_memory(get_memory()));
+        return result;
+    }
+};
+
+class commandBuffer {
+    friend class commandPool;//封装命令池的commandPool类负责分配和释放命令缓冲区，需要让其能访问私有成员handle
+    VkCommandBuffer handle = VK_NULL_HANDLE;
+public:
+    commandBuffer() = default;
+    commandBuffer(commandBuffer&& other) noexcept { MoveHandle; }
+    //因释放命令缓冲区的函数被定义在封装命令池的commandPool类中，没有析构器
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Const Function
+    result_t begin(VkCommandBufferUsageFlags usageFlags = 0) const {
+        VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = usageFlags
+        };
+        VkResult result = graphics_base.dispatch.vkBeginCommandBuffer(handle, &beginInfo);
+        if (result)
+            LogError("[ commandBuffer ] ERROR\nFailed to begin a command buffer!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    result_t end() const {
+        VkResult result = graphics_base.dispatch.vkEndCommandBuffer(handle);
+        if (result)
+            LogError("[ commandBuffer ] ERROR\nFailed to end a command buffer!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+};
+
+class commandPool {
+    VkCommandPool handle = VK_NULL_HANDLE;
+public:
+    commandPool() = default;
+    commandPool(VkCommandPoolCreateInfo& createInfo) {
+        create(createInfo);
+    }
+    commandPool(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags = 0) {
+        create(queueFamilyIndex, flags);
+    }
+    commandPool(commandPool&& other) noexcept { MoveHandle; }
+    ~commandPool() { DestroyHandleBy(vkDestroyCommandPool); }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Const Function
+    result_t allocate_buffers(std::span<VkCommandBuffer> buffers, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) const {
+        VkCommandBufferAllocateInfo allocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = handle,
+            .level = level,
+            .commandBufferCount = uint32_t(buffers.size())
+        };
+        VkResult result = graphics_base.dispatch.vkAllocateCommandBuffers(graphics_base.device, &allocateInfo, buffers.data());
+        if (result)
+            LogError("[ commandPool ] ERROR\nFailed to allocate command buffers!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    result_t allocate_buffers(std::span<commandBuffer> buffers, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY) const {
+        static_assert(sizeof(commandBuffer) == sizeof(VkCommandBuffer));
+        return allocate_buffers({ &buffers[0].handle, buffers.size() }, level);
+    }
+    void free_buffers(std::span<VkCommandBuffer> buffers) const {
+        graphics_base.dispatch.vkFreeCommandBuffers(graphics_base.device, handle, uint32_t(buffers.size()), buffers.data());
+        memset(buffers.data(), 0, buffers.size() * sizeof(VkCommandBuffer));
+    }
+    void free_buffers(std::span<commandBuffer> buffers) const {
+        free_buffers({ &buffers[0].handle, buffers.size() });
+    }
+    //Non-const Function
+    result_t create(VkCommandPoolCreateInfo& createInfo) {
+        createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreateCommandPool(graphics_base.device, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ commandPool ] ERROR\nFailed to create a command pool!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    result_t create(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags = 0) {
+        VkCommandPoolCreateInfo createInfo = {
+            .flags = flags,
+            .queueFamilyIndex = queueFamilyIndex
+        };
+        return create(createInfo);
+    }
+};
+
+class image {
+    VkImage handle = VK_NULL_HANDLE;
+public:
+    image() = default;
+    image(VkImageCreateInfo& createInfo) {
+        create(createInfo);
+    }
+    image(image&& other) noexcept { MoveHandle; }
+    ~image() { DestroyHandleBy(vkDestroyImage); }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Const Function
+    VkMemoryRequirements memory_requirements() const {
+        VkMemoryRequirements memoryRequirements;
+        graphics_base.dispatch.vkGetImageMemoryRequirements(graphics_base.device, handle, &memoryRequirements);
+        return memoryRequirements;
+    }
+    result_t bind_memory(VkDeviceMemory deviceMemory, VkDeviceSize memoryOffset = 0) const {
+        VkResult result = graphics_base.dispatch.vkBindImageMemory(graphics_base.device, handle, deviceMemory, memoryOffset);
+        if (result)
+            LogError("[ image ] ERROR\nFailed to attach the memory!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    //Non-const Function
+    result_t create(VkImageCreateInfo& createInfo) {
+        createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreateImage(graphics_base.device, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ image ] ERROR\nFailed to create an image!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+};
+
+//图像及其独占的设备内存，析构时先销毁图像再释放内存
+class imageMemory :deviceMemory, image {
+public:
+    imageMemory() = default;
+    imageMemory(VkImageCreateInfo& createInfo, VkMemoryPropertyFlags desired_memory_properties) {
+        create(createInfo, desired_memory_properties);
+    }
+    imageMemory(imageMemory&& other) noexcept :
+        deviceMemory(std::move(other)), image(std::move(other)) {}
+    //Getter
+    VkImage get_image() const { return static_cast<const image&>(*this); }
+    const VkImage* address_of_image() const { return image::Address(); }
+    VkDeviceMemory get_memory() const { return static_cast<const deviceMemory&>(*this); }
+    using deviceMemory::size;
+    using deviceMemory::properties;
+    //Non-const Function
+    result_t create(VkImageCreateInfo& createInfo, VkMemoryPropertyFlags desired_memory_properties) {
+        VkResult result = image::create(createInfo);
+        result || (result = deviceMemory::allocate(memory_requirements(), desired_memory_properties));
+        result || (result = bind_memory(get_memory()));
+        return result;
+    }
+};
+
+class shaderModule {
+    VkShaderModule handle = VK_NULL_HANDLE;
+public:
+    shaderModule() = default;
+    shaderModule(VkShaderModuleCreateInfo& createInfo) {
+        create(createInfo);
+    }
+    shaderModule(const char* filepath /*VkShaderModuleCreateFlags flags*/) {
+        create(filepath);
+    }
+    shaderModule(size_t codeSize, const uint32_t* pCode /*VkShaderModuleCreateFlags flags*/) {
+        create(codeSize, pCode);
+    }
+    shaderModule(shaderModule&& other) noexcept { MoveHandle; }
+    ~shaderModule() { DestroyHandleBy(vkDestroyShaderModule); }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Const Function
+    VkPipelineShaderStageCreateInfo stage_create_info(VkShaderStageFlagBits stage, const char* entry = "main") const {
+        return {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = stage,
+            .module = handle,
+            .pName = entry
+        };
+    }
+    //Non-const Function
+    result_t create(VkShaderModuleCreateInfo& createInfo) {
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreateShaderModule(graphics_base.device, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ shaderModule ] ERROR\nFailed to create a shader module!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    //从SPIR-V文件创建
+    result_t create(const char* filepath /*VkShaderModuleCreateFlags flags*/) {
+        std::ifstream file(filepath, std::ios::ate | std::ios::binary);
+        if (!file) {
+            LogError("[ shaderModule ] ERROR\nFailed to open the file: {}\n", filepath);
+            return VK_RESULT_MAX_ENUM;
+        }
+        size_t fileSize = size_t(file.tellg());
+        //SPIR-V由32位的字组成
+        if (!fileSize || fileSize % 4) {
+            LogError("[ shaderModule ] ERROR\nInvalid SPIR-V file size: {}\nFile: {}\n", fileSize, filepath);
+            return VK_RESULT_MAX_ENUM;
+        }
+        std::vector<uint32_t> binaries(fileSize / 4);
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(binaries.data()), fileSize);
+        if (!file) {
+            LogError("[ shaderModule ] ERROR\nFailed to read the file: {}\n", filepath);
+            return VK_RESULT_MAX_ENUM;
+        }
+        file.close();
+        return create(fileSize, binaries.data());
+    }
+    result_t create(size_t codeSize, const uint32_t* pCode /*VkShaderModuleCreateFlags flags*/) {
+        VkShaderModuleCreateInfo createInfo = {
+            .codeSize = codeSize,
+            .pCode = pCode
+        };
+        return create(createInfo);
+    }
+};
+
+class pipelineLayout {
+    VkPipelineLayout handle = VK_NULL_HANDLE;
+public:
+    pipelineLayout() = default;
+    pipelineLayout(VkPipelineLayoutCreateInfo& createInfo) {
+        create(createInfo);
+    }
+    pipelineLayout(pipelineLayout&& other) noexcept { MoveHandle; }
+    ~pipelineLayout() { DestroyHandleBy(vkDestroyPipelineLayout); }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Non-const Function
+    result_t create(VkPipelineLayoutCreateInfo& createInfo) {
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreatePipelineLayout(graphics_base.device, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ pipelineLayout ] ERROR\nFailed to create a pipeline layout!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+};
+
+//未指定VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT时，管线缓存可在多个线程上同时用于创建管线
+class pipelineCache {
+    VkPipelineCache handle = VK_NULL_HANDLE;
+public:
+    pipelineCache() = default;
+    pipelineCache(VkPipelineCacheCreateInfo& createInfo) {
+        create(createInfo);
+    }
+    pipelineCache(pipelineCache&& other) noexcept { MoveHandle; }
+    ~pipelineCache() { DestroyHandleBy(vkDestroyPipelineCache); }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Const Function
+    result_t get_data(std::vector<uint8_t>& data) const {
+        size_t dataSize = 0;
+        VkResult result = graphics_base.dispatch.vkGetPipelineCacheData(graphics_base.device, handle, &dataSize, nullptr);
+        if (!result) {
+            data.resize(dataSize);
+            result = graphics_base.dispatch.vkGetPipelineCacheData(graphics_base.device, handle, &dataSize, data.data());
+            data.resize(dataSize);
+        }
+        if (result)
+            LogError("[ pipelineCache ] ERROR\nFailed to get the data of the pipeline cache!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    //Non-const Function
+    result_t create(VkPipelineCacheCreateInfo& createInfo) {
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreatePipelineCache(graphics_base.device, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ pipelineCache ] ERROR\nFailed to create a pipeline cache!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+};
+
+class pipeline {
+    VkPipeline handle = VK_NULL_HANDLE;
+public:
+    pipeline() = default;
+    pipeline(VkGraphicsPipelineCreateInfo& createInfo, VkPipelineCache cache = VK_NULL_HANDLE) {
+        create(createInfo, cache);
+    }
+    pipeline(VkComputePipelineCreateInfo& createInfo, VkPipelineCache cache = VK_NULL_HANDLE) {
+        create(createInfo, cache);
+    }
+    pipeline(pipeline&& other) noexcept { MoveHandle; }
+    ~pipeline() { DestroyHandleBy(vkDestroyPipeline); }
+    //Getter
+    DefineHandleTypeOperator;
+    DefineAddressFunction;
+    //Non-const Function
+    result_t create(VkGraphicsPipelineCreateInfo& createInfo, VkPipelineCache cache = VK_NULL_HANDLE) {
+        createInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreateGraphicsPipelines(graphics_base.device, cache, 1, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ pipeline ] ERROR\nFailed to create a graphics pipeline!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+    result_t create(VkComputePipelineCreateInfo& createInfo, VkPipelineCache cache = VK_NULL_HANDLE) {
+        createInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        VkResult result = graphics_base.dispatch.vkCreateComputePipelines(graphics_base.device, cache, 1, &createInfo, nullptr, &handle);
+        if (result)
+            LogError("[ pipeline ] ERROR\nFailed to create a compute pipeline!\nError code: {}\n", int32_t(result));
+        return result;
+    }
+};
 
 }
\ No newline at end of file
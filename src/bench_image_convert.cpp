@@ -0,0 +1,137 @@
+//图像转换函数的基准测试：对比标量、SSSE3、AVX2实现的吞吐量，并校验SIMD结果与标量一致
+#include "ImageConvert.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace vulkan::image_convert;
+
+constexpr uint32_t width = 4096;
+constexpr uint32_t height = 4096;
+constexpr int repeat = 10;
+
+/*
+计时前先在小尺寸上逐一比较SIMD与标量的结果：奇数宽度会走到SIMD循环剩下的尾部，
+1像素宽或高的图像及mip链末尾的各级只经过尾部处理，带行距的布局则不能合并成一行处理。
+输出缓冲区先填入相同的内容，因此行距中的填充字节若被写入也会被发现。
+*/
+int check_small_sizes(const std::vector<simdLevel>& levels) {
+    constexpr uint32_t max_width = 39;
+    constexpr uint32_t max_height = 8;
+    constexpr size_t src_padding = 12; //额外的行距，刻意不是16的倍数
+    constexpr size_t dst_padding = 20;
+    std::mt19937 rng(7);
+    std::vector<uint8_t> src(size_t(max_width * 4 + src_padding) * max_height);
+    for (auto& i : src)
+        i = uint8_t(rng());
+    size_t dst_size = std::max(size_t(max_width * 4 + dst_padding) * max_height, mip_chain_size_rgba(max_width, max_height));
+    std::vector<uint8_t> reference(dst_size);
+    std::vector<uint8_t> output(dst_size);
+    size_t reference_offsets[32];
+    size_t output_offsets[32];
+    int failed = 0;
+    for (uint32_t height = 1; height <= max_height; height++)
+        for (uint32_t width = 1; width <= max_width; width++)
+            for (bool pitched : { false, true }) {
+                size_t src_rgb_pitch = pitched ? width * 3 + src_padding : 0;
+                size_t src_rgba_pitch = pitched ? width * 4 + src_padding : 0;
+                size_t dst_pitch = pitched ? width * 4 + dst_padding : 0;
+                size_t half_pitch = pitched ? std::max(width >> 1, 1u) * 4 + dst_padding : 0;
+                auto check = [&](const char* name, auto&& run) {
+                    std::fill(reference.begin(), reference.end(), uint8_t(0xcd));
+                    run(reference.data(), reference_offsets, simdLevel::scalar);
+                    for (simdLevel level : levels) {
+                        if (level == simdLevel::scalar)
+                            continue;
+                        std::fill(output.begin(), output.end(), uint8_t(0xcd));
+                        run(output.data(), output_offsets, level);
+                        if (std::memcmp(reference.data(), output.data(), dst_size)) {
+                            std::printf("MISMATCH %s %s %ux%u%s\n", name, simd_level_name(level), width, height, pitched ? " pitched" : "");
+                            failed++;
+                        }
+                    }
+                };
+                check("rgb_to_rgba", [&](uint8_t* dst, size_t*, simdLevel level) {
+                    rgb_to_rgba(src.data(), src_rgb_pitch, dst, dst_pitch, width, height, 255, level); });
+                check("swizzle_rgba_to_bgra", [&](uint8_t* dst, size_t*, simdLevel level) {
+                    swizzle_rgba(src.data(), src_rgba_pitch, dst, dst_pitch, width, height, swizzle_rgba_to_bgra, level); });
+                check("premultiply_alpha", [&](uint8_t* dst, size_t*, simdLevel level) {
+                    premultiply_alpha(src.data(), src_rgba_pitch, dst, dst_pitch, width, height, level); });
+                check("downsample_rgba", [&](uint8_t* dst, size_t*, simdLevel level) {
+                    downsample_rgba(src.data(), src_rgba_pitch, width, height, dst, half_pitch, level); });
+                check("generate_mip_chain_rgba", [&](uint8_t* dst, size_t* offsets, simdLevel level) {
+                    generate_mip_chain_rgba(src.data(), src_rgba_pitch, width, height, dst, offsets, level); });
+            }
+    std::printf("Small size check (widths 1-%u, heights 1-%u, tight and pitched): %s\n",
+        max_width, max_height, failed ? "FAILED" : "passed");
+    return failed;
+}
+
+template<typename Func>
+double measure(Func&& func) {
+    func();//预热，顺便让页面分配到位
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < repeat; i++)
+        func();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1 - t0).count() / repeat;
+}
+
+int main() {
+    std::vector<uint8_t> rgb(size_t(width) * height * 3);
+    std::vector<uint8_t> rgba(size_t(width) * height * 4);
+    std::mt19937 rng(42);
+    for (auto& i : rgb)
+        i = uint8_t(rng());
+    for (auto& i : rgba)
+        i = uint8_t(rng());
+    std::vector<uint8_t> reference(mip_chain_size_rgba(width, height));
+    std::vector<uint8_t> output(reference.size());
+
+    simdLevel best = simd_level();
+    std::printf("Image: %ux%u, best SIMD level: %s\n", width, height, simd_level_name(best));
+    std::vector<simdLevel> levels = { simdLevel::scalar };
+#ifdef IMAGE_CONVERT_X86
+    if (best >= simdLevel::ssse3)
+        levels.push_back(simdLevel::ssse3);
+    if (best >= simdLevel::avx2)
+        levels.push_back(simdLevel::avx2);
+#endif
+
+    struct kernel {
+        const char* name;
+        size_t bytes;//每次调用读写的字节数，用于计算吞吐量
+        size_t output_bytes;
+        void(*run)(const std::vector<uint8_t>& rgb, const std::vector<uint8_t>& rgba, uint8_t* dst, simdLevel level);
+    };
+    const kernel kernels[] = {
+        { "rgb_to_rgba", size_t(width) * height * 7, size_t(width) * height * 4,
+            [](auto& rgb, auto&, uint8_t* dst, simdLevel level) { rgb_to_rgba(rgb.data(), 0, dst, 0, width, height, 255, level); } },
+        { "swizzle_rgba_to_bgra", size_t(width) * height * 8, size_t(width) * height * 4,
+            [](auto&, auto& rgba, uint8_t* dst, simdLevel level) { swizzle_rgba(rgba.data(), 0, dst, 0, width, height, swizzle_rgba_to_bgra, level); } },
+        { "premultiply_alpha", size_t(width) * height * 8, size_t(width) * height * 4,
+            [](auto&, auto& rgba, uint8_t* dst, simdLevel level) { premultiply_alpha(rgba.data(), 0, dst, 0, width, height, level); } },
+        { "generate_mip_chain_rgba", mip_chain_size_rgba(width, height) * 2, mip_chain_size_rgba(width, height),
+            [](auto&, auto& rgba, uint8_t* dst, simdLevel level) { generate_mip_chain_rgba(rgba.data(), 0, width, height, dst, nullptr, level); } }
+    };
+
+    int failed = check_small_sizes(levels);
+    for (auto& k : kernels) {
+        double scalar_time = 0;
+        for (simdLevel level : levels) {
+            uint8_t* dst = level == simdLevel::scalar ? reference.data() : output.data();
+            double time = measure([&] { k.run(rgb, rgba, dst, level); });
+            if (level == simdLevel::scalar)
+                scalar_time = time;
+            bool match = level == simdLevel::scalar || std::memcmp(reference.data(), output.data(), k.output_bytes) == 0;
+            failed += !match;
+            std::printf("%-24s %-7s %8.3f ms %9.1f MB/s  x%.2f%s\n",
+                k.name, simd_level_name(level), time * 1e3, k.bytes / time / 1e6, scalar_time / time,
+                match ? "" : "  MISMATCH");
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,24 +1,299 @@
 #include <iostream>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "GlfwGeneral.hpp"
+#include "Transform.h"
+#include "FrameArena.h"
+#include "Readback.h"
+#ifndef _WIN32
+#include "RenderServer.h"
+#endif
+#include "PipelineService.h"
+#include <charconv>
 
 using namespace vulkan;
 
+//用来演示实例变换系统的实例数量
+constexpr uint32_t demo_instance_count = 1 << 16;
+//飞行中的帧数，每帧各有栅栏、命令缓冲区、实例缓冲区和arena，第i帧使用第i % frame_in_flight_count套
+constexpr uint32_t frame_in_flight_count = 2;
+//无窗口运行时离屏渲染目标的格式，尺寸同default_window_size
+constexpr VkFormat offscreen_format = VK_FORMAT_R8G8B8A8_UNORM;
 
-int main() {
-    if (!InitializeWindow({1280,720}))
+/*
+命令行参数：
+--headless <帧数>  不创建窗口，渲染指定帧数到离屏图像后退出，时间按每帧1/60秒推进，因此输出是确定的
+--capture <目录>   回读每帧并写到该目录（目前仅在--headless下可用，交换链要等渲染过程填充后再接上）
+--raw              回读的帧写成单个原始RGBA文件，而非每帧一个PNG
+--server <路径>    不创建窗口，作为常驻的渲染服务在该Unix域套接字上接受任务，协议见RenderServer.h（Windows上不可用）
+--client <路径> [命令...]  作为客户端把命令（未给出时从标准输入逐行读取）一次性发给服务，按序打印回应（Windows上不可用）
+--trace <文件>     把每帧各Vulkan函数的调用次数和耗时写成CSV，须以VK_TRACE_CALLS编译
+*/
+#ifndef _WIN32
+int RunClient(const char* socket_path, std::span<char*> commands) {
+    renderClient client;
+    if (!client.connect(socket_path))
+        return -1;
+    std::vector<std::string> lines(commands.begin(), commands.end());
+    if (lines.empty())
+        for (std::string line; std::getline(std::cin, line);)
+            lines.push_back(std::move(line));
+    auto begin = std::chrono::steady_clock::now();
+    for (auto& i : lines)
+        if (!client.send_command(i))
+            return -1;
+    std::string response;
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (!client.receive_response(response)) {
+            LogError("[ RunClient ] ERROR\nConnection closed after {} of {} response(s)!\n", i, lines.size());
+            logger.flush();
+            return -1;
+        }
+        std::cout << response << '\n';
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    LogInfo("[ RunClient ]\n{} job(s) in {:.3f} s, {:.2f} jobs/s\n", lines.size(), seconds, lines.size() / seconds);
+    logger.flush();
+    return 0;
+}
+#endif
+
+int main(int argc, char** argv) {
+    uint32_t headless_frame_count = 0;
+    const char* capture_directory = nullptr;
+    const char* server_socket = nullptr;
+    const char* trace_path = nullptr;
+    readbackFileFormat capture_format = readbackFileFormat::png;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--headless") && i + 1 < argc)
+            headless_frame_count = uint32_t(atoi(argv[++i]));
+        else if (!strcmp(argv[i], "--capture") && i + 1 < argc)
+            capture_directory = argv[++i];
+        else if (!strcmp(argv[i], "--raw"))
+            capture_format = readbackFileFormat::raw;
+#ifndef _WIN32
+        else if (!strcmp(argv[i], "--server") && i + 1 < argc)
+            server_socket = argv[++i];
+        else if (!strcmp(argv[i], "--client") && i + 1 < argc)
+            return RunClient(argv[i + 1], { argv + i + 2, size_t(argc - i - 2) });
+#else
+        else if (!strcmp(argv[i], "--server") && i + 1 < argc) {
+            LogWarning("[ main ] WARNING\n--server is not supported on Windows and is ignored!\n");
+            i++;
+        }
+        else if (!strcmp(argv[i], "--client")) {
+            LogWarning("[ main ] WARNING\n--client is not supported on Windows!\n");
+            logger.flush();
+            return -1;
+        }
+#endif
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+            trace_path = argv[++i];
+    }
+    bool headless = headless_frame_count || server_socket;
+
+    if (headless ? !InitializeHeadless() : !InitializeWindow({1280,720}))
         return -1;//来个你讨厌的返回值
-    std::cout << std::format("[ InitializeWindow ]\nWindow created successfully!\n");
+    if (!headless)
+        LogInfo("[ InitializeWindow ]\nWindow created successfully!\n");
+#ifdef VK_TRACE_CALLS
+    if (trace_path)
+        call_tracer.open_trace_file(trace_path);
+#else
+    if (trace_path)
+        LogWarning("[ main ] WARNING\n--trace is ignored because VK_TRACE_CALLS is not defined!\n");
+#endif
 
-    fence fence(VK_FENCE_CREATE_SIGNALED_BIT); //以置位状态创建栅栏
+    std::vector<fence> fences;
+    fences.reserve(frame_in_flight_count);
+    for (uint32_t i = 0; i < frame_in_flight_count; i++)
+        fences.emplace_back(VK_FENCE_CREATE_SIGNALED_BIT); //以置位状态创建栅栏
     semaphore semaphore_image_is_available;
     semaphore semaphore_rendering_is_over;
-    
-    while (!glfwWindowShouldClose(pWindow)) {
-        /*渲染过程，待填充*/
 
-        glfwPollEvents();
-        TitleFps();
+    jobSystem job_system; //构造调度器的线程（即主线程）为其0号线程
+    //管线在各工作线程上并行编译，缓存数据和预热列表存放在工作目录下，渲染过程填充后在此add(...)各管线
+    pipelineService pipelines(job_system, "pipeline_cache.bin", "pipeline_warm_up.txt");
+    pipelines.compile_all();
+    instanceTransforms transforms(demo_instance_count);
+    for (uint32_t i = 0; i < demo_instance_count; i++)
+        transforms.add(glm::vec3(i % 256, 0, i / 256));
+    //GPU读取某帧的实例数据时，CPU写的是另一帧的
+    instanceBuffer instance_buffer(demo_instance_count, frame_in_flight_count);
+    //每帧的临时数据（屏障、描述符写入、提交信息等）从这里分配
+    frameArenas frame_arenas(frame_in_flight_count, 64 * 1024);
+
+    //无窗口运行时渲染到离屏图像，渲染过程填充前先以清屏代替
+    imageMemory offscreen_image;
+    commandPool command_pool;
+    commandBuffer command_buffers[frame_in_flight_count];
+    frameReadback readback;
+    if (headless) {
+        VkImageCreateInfo imageCreateInfo = {
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = offscreen_format,
+            .extent = { default_window_size.width, default_window_size.height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+        };
+        if (offscreen_image.create(imageCreateInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ||
+            command_pool.create(graphics_base.queue_family_index_graphics, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT) ||
+            command_pool.allocate_buffers(command_buffers))
+            return -1;
+        //回归测试需要每一帧，因此不丢帧
+        if (capture_directory && !server_socket &&
+            readback.create(default_window_size, offscreen_format, capture_directory, capture_format, 3, false))
+            return -1;
+    }
+
+    //模拟：让各实例绕y轴旋转，并把世界矩阵直接写入实例缓冲区，分批在工作线程上进行
+    float time = 0;
+    uint32_t frame_slot = 0; //当前帧使用的那一套每帧资源
+    auto simulate = [&](uint32_t first, uint32_t count) {
+        float* qy = transforms.rotation_data(1);
+        float* qw = transforms.rotation_data(3);
+        for (uint32_t i = first; i < first + count; i++) {
+            float half_angle = 0.5f * time + i * 0.001f;
+            qy[i] = std::sin(half_angle);
+            qw[i] = std::cos(half_angle);
+        }
+        transforms.update_range(first, count, instance_buffer.data(frame_slot));
+    };
+    auto begin_simulation = [&](uint32_t frame_index, float frame_time, jobCounter& simulation) {
+        //等GPU用完这一套资源再重置arena、写实例缓冲区，栅栏在提交前才重置
+        frame_slot = frame_index % frame_in_flight_count;
+        if (fences[frame_slot].wait())
+            return false;
+        frame_arenas.begin_frame(frame_slot);
+        time = frame_time;
+        job_system.parallel_for(transforms.size(), 4096, simulate, simulation);
+        /*剔除、命令录制、资源解码等同样以任务的形式提交，用各自的jobCounter表示依赖，待填充*/
+        return true;
+    };
+    //渲染一帧到离屏图像，并按需回读；渲染过程填充前先以清屏代替
+    auto render_offscreen = [&](uint32_t frame_index, frameReadback* readback) {
+        //已在begin_simulation(...)中等待
+        if (fences[frame_slot].reset())
+            return false;
+        commandBuffer& command_buffer = command_buffers[frame_slot];
+        command_buffer.begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        //屏障和提交信息分配在本帧的arena上，稳定运行时不产生堆分配
+        auto imageMemoryBarriers = frame_arenas.make_vector<VkImageMemoryBarrier>(1);
+        VkImageMemoryBarrier& imageMemoryBarrier = imageMemoryBarriers.emplace_back(VkImageMemoryBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = offscreen_image.get_image(),
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+        });
+        //上一帧的回读也是传输操作，等它读完再覆盖
+        graphics_base.dispatch.vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, uint32_t(imageMemoryBarriers.size()), imageMemoryBarriers.data());
+        VkClearColorValue clearColor = { .float32 = { 0.5f + 0.5f * std::sin(time), 0.5f + 0.5f * std::cos(time), 0.5f, 1.f } };
+        graphics_base.dispatch.vkCmdClearColorImage(command_buffer, offscreen_image.get_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            &clearColor, 1, &imageMemoryBarrier.subresourceRange);
+        command_buffer.end();
+        VkSubmitInfo* pSubmitInfo = frame_arenas.current().make<VkSubmitInfo>(VkSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = command_buffer.Address()
+        });
+        if (VkResult result = graphics_base.dispatch.vkQueueSubmit(graphics_base.queue_graphics, 1, pSubmitInfo, fences[frame_slot])) {
+            LogError("[ main ] ERROR\nFailed to submit the offscreen frame!\nError code: {}\n", int32_t(result));
+            return false;
+        }
+        //回读与渲染在同一队列上，按提交顺序执行，无需信号量
+        if (readback) {
+            readback->capture(offscreen_image.get_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, frame_index);
+            readback->poll();
+        }
+        return true;
+    };
+
+#ifndef _WIN32
+    if (server_socket) {
+        renderServer server;
+        //用于测量服务本身的开销
+        server.register_handler("ping", [](std::string_view arguments, std::string& result) {
+            result = std::format("pong {}", arguments);
+            return true;
+        });
+        //render <帧数> [回读目录]：渲染指定帧数，执行时间包含GPU完成最后一帧的时间
+        server.register_handler("render", [&](std::string_view arguments, std::string& result) {
+            uint32_t frame_count = 0;
+            auto [end, error] = std::from_chars(arguments.data(), arguments.data() + arguments.size(), frame_count);
+            if (error != std::errc() || !frame_count) {
+                result = "usage: render <frame count> [capture directory]";
+                return false;
+            }
+            std::string_view directory(end, arguments.data() + arguments.size());
+            while (directory.starts_with(' '))
+                directory.remove_prefix(1);
+            frameReadback job_readback;
+            if (!directory.empty() &&
+                job_readback.create(default_window_size, offscreen_format, directory, readbackFileFormat::png, 3, false)) {
+                result = "failed to create the readback";
+                return false;
+            }
+            for (uint32_t i = 0; i < frame_count; i++) {
+                jobCounter simulation;
+                if (!begin_simulation(i, i / 60.f, simulation)) {
+                    result = std::format("failed at frame {}", i);
+                    return false;
+                }
+                job_system.wait(simulation);
+                instance_buffer.flush(frame_slot, transforms.size());
+                if (!render_offscreen(i, directory.empty() ? nullptr : &job_readback)) {
+                    result = std::format("failed at frame {}", i);
+                    return false;
+                }
+                TraceFrameEnd();
+            }
+            for (auto& i : fences)
+                i.wait();
+            job_readback.finish();
+            result = std::format("rendered {} frame(s)", frame_count);
+            return true;
+        });
+        if (!server.listen(server_socket))
+            return -1;
+        server.run();
+        LogInfo("[ main ]\nServer stopped, {}\n", server.format_statistics());
+        pipelines.save();
+        TerminateWindow();
+        return 0;
+    }
+#endif
+
+    for (uint32_t frame_index = 0; headless ? frame_index < headless_frame_count : !glfwWindowShouldClose(pWindow); frame_index++) {
+        jobCounter simulation;
+        if (!begin_simulation(frame_index, headless ? frame_index / 60.f : float(glfwGetTime()), simulation))
+            break;
+
+        //GLFW的事件处理只能在主线程上进行，它与上面的任务并行
+        if (!headless) {
+            glfwPollEvents();
+            TitleFps();
+        }
+
+        //主线程只等待渲染需要的结果，等待期间也会执行任务
+        job_system.wait(simulation);
+        instance_buffer.flush(frame_slot, transforms.size());
+        /*渲染过程，待填充*/
+        if (headless && !render_offscreen(frame_index, capture_directory ? &readback : nullptr))
+            break;
+        TraceFrameEnd();
+    }
+    if (headless && capture_directory) {
+        readback.finish();
+        LogInfo("[ main ]\n{} frame(s) captured, {} written, {} dropped\n",
+            readback.captured_frame_count(), readback.written_frame_count(), readback.dropped_count());
     }
+    pipelines.save();
     TerminateWindow();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,96 @@
+//frameArenas的测试：预热之后，反复begin_frame(...)并在arena上分配（含arenaVector扩容）不应再有任何operator new调用
+#include "FrameArena.h"
+#include <cstdio>
+#include <cstdlib>
+
+DefineCountingOperatorNew
+
+using namespace vulkan;
+
+constexpr uint32_t frame_in_flight_count = 2;
+constexpr uint32_t usage_period = 100; //每帧的用量以此为周期变化
+constexpr uint32_t frame_count = usage_period * 4;
+
+//模拟VkImageMemoryBarrier之类的每帧数据
+struct barrier {
+    uint64_t image;
+    uint32_t old_layout;
+    uint32_t new_layout;
+};
+struct alignas(64) cacheLineData {
+    uint32_t value[16];
+};
+
+int failed = 0;
+#define Check(condition, ...) \
+    if (!(condition)) { \
+        std::printf("FAILED: " __VA_ARGS__); \
+        std::printf("\n"); \
+        failed++; \
+    }
+
+//用量随帧号周期性变化，经过一个周期后arena的容量就不再增长
+void record_frame(frameArenas& arenas, uint32_t frame) {
+    linearArena& arena = arenas.current();
+    uint32_t phase = frame % usage_period;
+    //reserve不足，push_back会多次扩容
+    auto barriers = arenas.make_vector<barrier>(2);
+    uint32_t barrier_count = 1 + phase % 37;
+    for (uint32_t i = 0; i < barrier_count; i++)
+        barriers.push_back({ frame * 100ull + i, i, i + 1 });
+    auto indices = arenaVector<uint32_t>(arenaAllocator<uint32_t>(arena));
+    for (uint32_t i = 0; i < phase; i++)
+        indices.push_back(i);
+    cacheLineData* data = arena.make<cacheLineData>();
+    Check(reinterpret_cast<uintptr_t>(data) % alignof(cacheLineData) == 0, "frame %u: misaligned allocation", frame);
+    data->value[0] = frame;
+    void* raw = arena.allocate(100 + phase * 3, 16);
+    Check(reinterpret_cast<uintptr_t>(raw) % 16 == 0, "frame %u: misaligned raw allocation", frame);
+    //分配之间互不覆盖
+    for (uint32_t i = 0; i < barrier_count; i++)
+        Check(barriers[i].image == frame * 100ull + i && barriers[i].new_layout == i + 1, "frame %u: barrier %u corrupted", frame, i);
+    for (uint32_t i = 0; i < indices.size(); i++)
+        Check(indices[i] == i, "frame %u: index %u corrupted", frame, i);
+    Check(data->value[0] == frame, "frame %u: object corrupted", frame);
+}
+
+//计数须覆盖对齐超过默认值的分配，否则这类分配会被漏掉
+void check_counting() {
+    uint64_t count_before = heap_allocation_count();
+    auto* aligned = new cacheLineData;
+    Check(reinterpret_cast<uintptr_t>(aligned) % alignof(cacheLineData) == 0, "misaligned heap allocation");
+    delete aligned;
+    auto* aligned_array = new cacheLineData[3];
+    Check(reinterpret_cast<uintptr_t>(aligned_array) % alignof(cacheLineData) == 0, "misaligned heap array allocation");
+    delete[] aligned_array;
+    auto* plain = new uint32_t[5];
+    delete[] plain;
+    uint64_t count = heap_allocation_count() - count_before;
+    Check(count == 3, "%llu heap allocation(s) counted, 3 expected", (unsigned long long)count);
+}
+
+int main() {
+    check_counting();
+    //初始容量刻意很小，前几帧会溢出并扩容
+    frameArenas arenas(frame_in_flight_count, 256);
+    uint64_t steady_state_allocation_count = 0;
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        uint64_t count_before = heap_allocation_count();
+        arenas.begin_frame(frame % frame_in_flight_count);
+        record_frame(arenas, frame);
+        uint64_t count = heap_allocation_count() - count_before;
+        //第一个周期用于预热
+        if (frame >= usage_period) {
+            Check(count == 0, "frame %u: %llu heap allocation(s) in a steady-state frame", frame, (unsigned long long)count);
+            steady_state_allocation_count += count;
+        }
+    }
+    //溢出后的各块在reset()时合并，容量至少是峰值
+    for (uint32_t i = 0; i < frame_in_flight_count; i++) {
+        linearArena& arena = arenas.begin_frame(i);
+        Check(arena.capacity() >= arena.peak_size(), "arena %u: capacity %zu below peak %zu", i, arena.capacity(), arena.peak_size());
+    }
+    std::printf("%u frame(s), %llu heap allocation(s) after warm-up: %s\n",
+        frame_count, (unsigned long long)steady_state_allocation_count, failed ? "FAILED" : "passed");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,238 @@
+//residencyManager的测试：不创建Vulkan实例和设备，手动设定显存堆的大小（不支持VK_EXT_memory_budget时以其一定比例为预算），
+//或以假的vkGetPhysicalDeviceMemoryProperties2(...)报告预算，以记录调用的回调代替实际的驱逐和载入
+#include "Residency.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace vulkan;
+
+constexpr VkDeviceSize heap_size = 1000;
+constexpr VkDeviceSize mip_sizes[] = { 256, 64, 16, 4 }; //各级之和为340
+constexpr uint32_t mip_count = std::size(mip_sizes);
+
+int failed = 0;
+#define Check(condition, ...) \
+    if (!(condition)) { \
+        std::printf("FAILED: " __VA_ARGS__); \
+        std::printf("\n"); \
+        failed++; \
+    }
+
+//回调的调用记录
+struct transition {
+    residencyManager::textureHandle texture;
+    uint32_t old_base_mip;
+    uint32_t new_base_mip;
+    bool operator==(const transition&) const = default;
+};
+std::vector<transition> transitions;
+bool record_transition(residencyManager::textureHandle texture, uint32_t old_base_mip, uint32_t new_base_mip) {
+    transitions.push_back({ texture, old_base_mip, new_base_mip });
+    return true;
+}
+
+VkDeviceSize resident_size(uint32_t base_mip) {
+    VkDeviceSize size = 0;
+    for (uint32_t i = base_mip; i < mip_count; i++)
+        size += mip_sizes[i];
+    return size;
+}
+//比较回调记录与期望的顺序，并清空记录
+void check_transitions(const char* step, std::initializer_list<transition> expected) {
+    Check(transitions.size() == expected.size() && std::equal(transitions.begin(), transitions.end(), expected.begin()),
+        "%s: %zu transition(s), %zu expected", step, transitions.size(), expected.size());
+    transitions.clear();
+}
+//本类记录的驻留大小须与各纹理的驻留级别一致，未知驱动用量时用量即驻留大小
+void check_resident_bytes(const char* step, const residencyManager& manager, std::initializer_list<residencyManager::textureHandle> textures, VkDeviceSize other_bytes = 0) {
+    VkDeviceSize expected = other_bytes;
+    for (auto i : textures)
+        expected += resident_size(manager.texture_resident_base_mip(i));
+    residencyManager::heapStatistics heap = manager.heap_statistics(0);
+    Check(heap.resident_bytes == expected, "%s: %llu resident byte(s), %llu expected", step, (unsigned long long)heap.resident_bytes, (unsigned long long)expected);
+    Check(heap.usage == heap.resident_bytes, "%s: usage %llu differs from resident bytes", step, (unsigned long long)heap.usage);
+}
+
+//超出预算时按最近最少使用的顺序逐级驱逐，闲置达到whole_eviction_age帧的整个驱逐，正在使用的不驱逐
+void test_eviction() {
+    residencySettings settings = {
+        .headroom = 0,
+        .min_idle_frames = 2,
+        .whole_eviction_age = 10
+    };
+    residencyManager manager(record_transition, settings);
+    Check(manager.heap_statistics(0).budget == 800, "budget %llu, 800 expected", (unsigned long long)manager.heap_statistics(0).budget);
+    auto a = manager.register_texture(0, mip_sizes);
+    auto b = manager.register_texture(0, mip_sizes);
+    auto c = manager.register_texture(0, mip_sizes);
+    //a最后用于第0帧，b最后用于第1帧，c一直在用
+    manager.use(a), manager.use(b), manager.use(c);
+    manager.update(0);
+    check_transitions("frame 0", {});
+    manager.use(b), manager.use(c);
+    manager.update(1);
+    check_transitions("frame 1", {});
+    //a闲置2帧，超出的220字节以丢弃a的mip 0补足
+    manager.use(c);
+    manager.update(2);
+    check_transitions("frame 2", { { a, 0, 1 } });
+    check_resident_bytes("frame 2", manager, { a, b, c });
+    manager.use(c);
+    manager.update(3);
+    check_transitions("frame 3", {});
+    //新纹理使用量超出304字节，先把a驱逐到最低一级，再驱逐b
+    auto d = manager.register_texture(0, mip_sizes);
+    manager.use(c), manager.use(d);
+    manager.update(4);
+    check_transitions("frame 4", { { a, 1, 2 }, { a, 2, 3 }, { b, 0, 1 } });
+    check_resident_bytes("frame 4", manager, { a, b, c, d });
+    for (uint64_t frame = 5; frame < 10; frame++) {
+        manager.use(c), manager.use(d);
+        manager.update(frame);
+    }
+    check_transitions("frames 5-9", {});
+    //a闲置10帧，整个驱逐；b闲置9帧，保留最低一级；c、d、e正在使用，即使仍超出预算也不驱逐
+    auto e = manager.register_texture(0, mip_sizes);
+    manager.use(c), manager.use(d), manager.use(e);
+    manager.update(10);
+    check_transitions("frame 10", { { a, 3, 4 }, { b, 1, 2 }, { b, 2, 3 } });
+    check_resident_bytes("frame 10", manager, { a, b, c, d, e });
+    Check(manager.texture_resident_base_mip(a) == mip_count, "texture a not evicted entirely");
+    const residencyManager::statistics& stats = manager.get_statistics();
+    Check(stats.evicted_texture_count == 1, "%u texture(s) evicted entirely, 1 expected", stats.evicted_texture_count);
+    Check(stats.evicted_mip_count == 7, "%u mip(s) evicted, 7 expected", stats.evicted_mip_count);
+    Check(stats.evicted_bytes == 340 + 336, "%llu byte(s) evicted", (unsigned long long)stats.evicted_bytes);
+    //注销后不再计入
+    manager.unregister_texture(e);
+    check_resident_bytes("unregistered", manager, { a, b, c, d });
+}
+
+//载入受预算和每帧上限限制时先载入较粗的mip，其余在之后的帧补齐
+void test_streaming() {
+    residencySettings settings = {
+        .headroom = 0,
+        .min_idle_frames = 2,
+        .whole_eviction_age = 10,
+        .stream_bytes_per_frame = 300
+    };
+    residencyManager manager(record_transition, settings);
+    auto t = manager.register_texture(0, mip_sizes);
+    const VkDeviceSize large_size[] = { 790 };
+    auto large = manager.register_texture(0, large_size);
+    for (uint64_t frame = 0; frame < 3; frame++) {
+        manager.use(large);
+        manager.update(frame);
+    }
+    //t闲置2帧后为large让出空间，只剩最低一级
+    check_transitions("frames 0-2", { { t, 0, 1 }, { t, 1, 2 }, { t, 2, 3 } });
+    check_resident_bytes("frames 0-2", manager, { t }, 790);
+    manager.unregister_texture(large);
+    const VkDeviceSize medium_size[] = { 750 };
+    auto medium = manager.register_texture(0, medium_size);
+    //mip 0超出每帧上限，mip 1超出预算且没有更久未用的纹理可驱逐，只载入mip 2
+    manager.use(t, 0), manager.use(medium);
+    manager.update(3);
+    check_transitions("frame 3", { { t, 3, 2 } });
+    check_resident_bytes("frame 3", manager, { t }, 750);
+    manager.unregister_texture(medium);
+    //空间足够后，每帧在上限内补齐一部分
+    manager.use(t, 0);
+    manager.update(4);
+    check_transitions("frame 4", { { t, 2, 1 } });
+    manager.use(t, 0);
+    manager.update(5);
+    check_transitions("frame 5", { { t, 1, 0 } });
+    check_resident_bytes("frame 5", manager, { t });
+    const residencyManager::statistics& stats = manager.get_statistics();
+    Check(stats.streamed_bytes == 336, "%llu byte(s) streamed, 336 expected", (unsigned long long)stats.streamed_bytes);
+    Check(stats.streamed_mip_count == 3, "%u mip(s) streamed, 3 expected", stats.streamed_mip_count);
+    Check(stats.deferred_request_count == 2, "%u deferred request(s), 2 expected", stats.deferred_request_count);
+}
+
+//VK_EXT_memory_budget的依赖：物理设备的属性须在启用扩展前取得（determine_physical_device(...)中），否则apiVersion为0
+void test_gating() {
+    graphicsBase& base = graphics_base;
+    uint32_t api_version = base.api_version;
+    uint32_t device_api_version = base.physical_device_properties.apiVersion;
+    base.api_version = VK_API_VERSION_1_0;
+    base.physical_device_properties.apiVersion = VK_API_VERSION_1_1;
+    Check(!base.physical_device_memory_properties2_name(), "Vulkan 1.0 instance without the extension accepted");
+    base.api_version = VK_API_VERSION_1_1;
+    base.physical_device_properties.apiVersion = 0;
+    Check(!base.physical_device_memory_properties2_name(), "accepted before the physical device properties are known");
+    base.physical_device_properties.apiVersion = VK_API_VERSION_1_1;
+    const char* name = base.physical_device_memory_properties2_name();
+    Check(name && !std::strcmp(name, "vkGetPhysicalDeviceMemoryProperties2"), "Vulkan 1.1 instance and device rejected");
+    base.api_version = VK_API_VERSION_1_0;
+    base.physical_device_properties.apiVersion = VK_API_VERSION_1_0;
+    base.add_instance_extension(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+    name = base.physical_device_memory_properties2_name();
+    Check(name && !std::strcmp(name, "vkGetPhysicalDeviceMemoryProperties2KHR"), "VK_KHR_get_physical_device_properties2 ignored");
+    base.instance_extensions.clear();
+    base.api_version = api_version;
+    base.physical_device_properties.apiVersion = device_api_version;
+}
+
+//假的驱动：预算固定，用量为其他分配加上本类管理的纹理
+constexpr VkDeviceSize driver_budget = 600;
+constexpr VkDeviceSize other_usage = 200;
+const residencyManager* queried_manager = nullptr;
+uint32_t query_count = 0;
+VKAPI_ATTR void VKAPI_CALL fake_get_memory_properties2(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties2* pMemoryProperties) {
+    auto budget = static_cast<VkPhysicalDeviceMemoryBudgetPropertiesEXT*>(pMemoryProperties->pNext);
+    budget->heapBudget[0] = driver_budget;
+    budget->heapUsage[0] = other_usage + (queried_manager ? queried_manager->heap_statistics(0).resident_bytes : 0);
+    query_count++;
+}
+
+//支持VK_EXT_memory_budget时以驱动的预算为准，用量包含其他分配
+void test_budget_query() {
+    residencySettings settings = {
+        .query_interval = 30,
+        .headroom = 0,
+        .min_idle_frames = 2,
+        .whole_eviction_age = 10
+    };
+    residencyManager manager(record_transition, fake_get_memory_properties2, settings);
+    queried_manager = &manager;
+    Check(manager.budget_query_supported(), "budget query unused");
+    auto a = manager.register_texture(0, mip_sizes);
+    auto b = manager.register_texture(0, mip_sizes);
+    residencyManager::heapStatistics heap = manager.heap_statistics(0);
+    Check(heap.budget == driver_budget, "budget %llu, %llu expected", (unsigned long long)heap.budget, (unsigned long long)driver_budget);
+    //两次查询之间以登记的纹理修正用量
+    Check(heap.usage == other_usage + 680, "usage %llu before the first update", (unsigned long long)heap.usage);
+    manager.use(a), manager.use(b);
+    manager.update(0);
+    manager.use(a);
+    manager.update(1);
+    check_transitions("budget frames 0-1", {});
+    //b闲置2帧，超出驱动预算的280字节须驱逐（以堆大小的比例为预算时不会超出）
+    manager.use(a);
+    manager.update(2);
+    check_transitions("budget frame 2", { { b, 0, 1 }, { b, 1, 2 } });
+    heap = manager.heap_statistics(0);
+    Check(heap.usage == other_usage + 360, "usage %llu after eviction", (unsigned long long)heap.usage);
+    Check(heap.resident_bytes == 360, "%llu resident byte(s) after eviction", (unsigned long long)heap.resident_bytes);
+    //再次查询后用量与修正的一致，未超出预算，不再驱逐
+    for (uint64_t frame = 3; frame <= 30; frame++) {
+        manager.use(a);
+        manager.update(frame);
+    }
+    check_transitions("budget frames 3-30", {});
+    Check(query_count == 3, "%u budget quer(ies), 3 expected", query_count);
+    Check(manager.heap_statistics(0).usage == other_usage + 360, "usage %llu after requery", (unsigned long long)manager.heap_statistics(0).usage);
+    queried_manager = nullptr;
+}
+
+int main() {
+    VkPhysicalDeviceMemoryProperties& memory_properties = graphics_base.physical_device_memory_properties;
+    memory_properties.memoryHeapCount = 1;
+    memory_properties.memoryHeaps[0] = { heap_size, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT };
+    test_gating();
+    test_eviction();
+    test_streaming();
+    test_budget_query();
+    std::printf("residencyManager: %s\n", failed ? "FAILED" : "passed");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}